@@ -54,6 +54,15 @@ Configuration::Defaults	()
 	channels = 2;
 	buffer_size = 128;
 	polyphony = 10;
+	block_size = 64;
+	render_threads = 1;
+	bandlimited_oscillators = false;
+	svf_filter = false;
+	control_period = 1;
+	random_seed = 0;
+	distortion_oversampling = 1;
+	limiter_lookahead_ms = 0;
+	note_priority = "last";
 	pitch_bend_range = 2;
 	jack_autoconnect = true;
 	jack_client_name_preference = "amsynth";
@@ -100,6 +109,33 @@ Configuration::load	()
 		} else if (buffer=="polyphony"){
 			file >> buffer;
 			istringstream(buffer) >> polyphony;
+		} else if (buffer=="block_size"){
+			file >> buffer;
+			istringstream(buffer) >> block_size;
+		} else if (buffer=="render_threads"){
+			file >> buffer;
+			istringstream(buffer) >> render_threads;
+		} else if (buffer=="bandlimited_oscillators"){
+			file >> buffer;
+			istringstream(buffer) >> bandlimited_oscillators;
+		} else if (buffer=="svf_filter"){
+			file >> buffer;
+			istringstream(buffer) >> svf_filter;
+		} else if (buffer=="control_period"){
+			file >> buffer;
+			istringstream(buffer) >> control_period;
+		} else if (buffer=="random_seed"){
+			file >> buffer;
+			istringstream(buffer) >> random_seed;
+		} else if (buffer=="distortion_oversampling"){
+			file >> buffer;
+			istringstream(buffer) >> distortion_oversampling;
+		} else if (buffer=="limiter_lookahead_ms"){
+			file >> buffer;
+			istringstream(buffer) >> limiter_lookahead_ms;
+		} else if (buffer=="note_priority"){
+			file >> buffer;
+			note_priority = buffer;
 		} else if (buffer=="pitch_bend_range"){
 			file >> buffer;
 			istringstream(buffer) >> pitch_bend_range;
@@ -133,6 +169,15 @@ Configuration::save	()
 	fprintf (fout, "alsa_audio_device\t%s\n", alsa_audio_device.c_str());
 	fprintf (fout, "sample_rate\t%d\n", sample_rate);
 	fprintf (fout, "polyphony\t%d\n", polyphony);
+	fprintf (fout, "block_size\t%d\n", block_size);
+	fprintf (fout, "render_threads\t%d\n", render_threads);
+	fprintf (fout, "bandlimited_oscillators\t%d\n", bandlimited_oscillators);
+	fprintf (fout, "svf_filter\t%d\n", svf_filter);
+	fprintf (fout, "control_period\t%d\n", control_period);
+	fprintf (fout, "random_seed\t%u\n", random_seed);
+	fprintf (fout, "distortion_oversampling\t%d\n", distortion_oversampling);
+	fprintf (fout, "limiter_lookahead_ms\t%g\n", limiter_lookahead_ms);
+	fprintf (fout, "note_priority\t%s\n", note_priority.c_str());
 	fprintf (fout, "pitch_bend_range\t%d\n", pitch_bend_range);
 	fprintf (fout, "tuning_file\t%s\n", current_tuning_file.c_str());
 	fprintf (fout, "ignored_parameters\t%s\n", ignored_parameters.c_str());
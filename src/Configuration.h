@@ -80,6 +80,50 @@ public:
 	 * unlimited polyphony.
 	 */
 	int polyphony;
+	/**
+	 * Maximum number of frames the synthesizer renders per internal block.
+	 */
+	int block_size;
+	/**
+	 * Number of threads used to render voices, including the audio thread.
+	 * 1 renders everything on the audio thread.
+	 */
+	int render_threads;
+	/**
+	 * Renders the oscillators from band-limited wavetables, which alias
+	 * less at high pitches but sound slightly different to older versions.
+	 */
+	bool bandlimited_oscillators;
+	/**
+	 * Moves the filter cutoff with the envelope and LFO every sample, rather
+	 * than once per block.
+	 */
+	bool svf_filter;
+	/**
+	 * Number of samples between updates of the LFO and filter envelope,
+	 * e.g. 8 or 16 to save CPU. 1 updates them every sample.
+	 */
+	int control_period;
+	/**
+	 * Seed for the noise generators, so that noise-based patches render
+	 * identically from one run to the next.
+	 */
+	unsigned random_seed;
+	/**
+	 * Runs the distortion effect at 1, 2 or 4 times the sample rate. Higher
+	 * factors alias less at heavy settings, at the cost of CPU and latency.
+	 */
+	int distortion_oversampling;
+	/**
+	 * Output limiter lookahead in milliseconds (0 to disable), which delays
+	 * the output so that the limiter can catch transients.
+	 */
+	float limiter_lookahead_ms;
+	/**
+	 * Which held note plays in mono and legato modes: "last" (the most
+	 * recently pressed), "low" or "high".
+	 */
+	std::string note_priority;
 	/*
 	 */
 	int pitch_bend_range;
@@ -0,0 +1,107 @@
+/*
+ *  DenormalGuard.h
+ *
+ *  Copyright (c) 2022 Nick Dowell
+ *
+ *  This file is part of amsynth.
+ *
+ *  amsynth is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  amsynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with amsynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DENORMALGUARD_H
+#define _DENORMALGUARD_H
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AMSYNTH_DENORMALS_SSE 1
+#include <xmmintrin.h>
+#elif defined(__aarch64__) && defined(__GNUC__)
+#define AMSYNTH_DENORMALS_AARCH64 1
+#endif
+
+/**
+ * Switches the calling thread's floating point unit to flush denormal
+ * results to zero and to treat denormal inputs as zero, restoring the
+ * previous mode when the guard goes out of scope.
+ *
+ * Decaying signals (filter states, envelopes, reverb tails) pass through
+ * the denormal range on their way to zero, where arithmetic can be a
+ * hundred times slower. With the guard in place the audio code needs no
+ * checks of its own. It does nothing on platforms where the mode can't be
+ * set.
+ */
+class DenormalGuard
+{
+public:
+	DenormalGuard()
+	{
+#if defined(AMSYNTH_DENORMALS_SSE)
+		mSaved = _mm_getcsr();
+		_mm_setcsr(mSaved | 0x8040); // FTZ | DAZ
+#elif defined(AMSYNTH_DENORMALS_AARCH64)
+		__asm__ __volatile__("mrs %0, fpcr" : "=r"(mSaved));
+		__asm__ __volatile__("msr fpcr, %0" : : "r"(mSaved | (1 << 24))); // FZ
+#endif
+	}
+
+	~DenormalGuard()
+	{
+#if defined(AMSYNTH_DENORMALS_SSE)
+		_mm_setcsr((unsigned) mSaved);
+#elif defined(AMSYNTH_DENORMALS_AARCH64)
+		__asm__ __volatile__("msr fpcr, %0" : : "r"(mSaved));
+#endif
+	}
+
+	DenormalGuard(const DenormalGuard &) = delete;
+	DenormalGuard & operator=(const DenormalGuard &) = delete;
+
+	/**
+	 * The calling thread's sticky flag for denormals having been flushed
+	 * (or denormal inputs met) since it was last cleared. Always false
+	 * where the mode can't be set.
+	 */
+	static bool underflowed()
+	{
+#if defined(AMSYNTH_DENORMALS_SSE)
+		return (_mm_getcsr() & kFlags) != 0;
+#elif defined(AMSYNTH_DENORMALS_AARCH64)
+		unsigned long fpsr;
+		__asm__ __volatile__("mrs %0, fpsr" : "=r"(fpsr));
+		return (fpsr & kFlags) != 0;
+#else
+		return false;
+#endif
+	}
+
+	static void clearUnderflow()
+	{
+#if defined(AMSYNTH_DENORMALS_SSE)
+		_mm_setcsr(_mm_getcsr() & ~kFlags);
+#elif defined(AMSYNTH_DENORMALS_AARCH64)
+		unsigned long fpsr;
+		__asm__ __volatile__("mrs %0, fpsr" : "=r"(fpsr));
+		__asm__ __volatile__("msr fpsr, %0" : : "r"(fpsr & ~kFlags));
+#endif
+	}
+
+private:
+#if defined(AMSYNTH_DENORMALS_SSE)
+	static constexpr unsigned kFlags = 0x0012; // UE | DE
+#elif defined(AMSYNTH_DENORMALS_AARCH64)
+	static constexpr unsigned long kFlags = 0x88; // IDC | UFC
+#endif
+	unsigned long mSaved = 0;
+};
+
+#endif
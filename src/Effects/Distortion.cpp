@@ -1,7 +1,7 @@
 /*
  *  Distortion.cpp
  *
- *  Copyright (c) 2001-2012 Nick Dowell
+ *  Copyright (c) 2001-2022 Nick Dowell
  *
  *  This file is part of amsynth.
  *
@@ -20,7 +20,21 @@
  */
 
 #include "Distortion.h"
-#include <math.h>
+
+#include "../VoiceBoard/FastMath.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+static const float kSettledTolerance = 1e-4f;
+static const float kMinExponent = 0.01f;
+
+static inline float shape(float x, float c)
+{
+	return std::copysign(fastmath::pow(std::fabs(x), c), x);
+}
 
 void 
 Distortion::SetCrunch	(float value)
@@ -28,17 +42,166 @@ Distortion::SetCrunch	(float value)
 	crunch=1-value;
 }
 
+void
+Distortion::SetOversampling	(int factor)
+{
+	mOversampler.setFactor(factor >= 4 ? 4 : factor >= 2 ? 2 : 1);
+}
+
+void
+Distortion::ProcessSilence	(float *buffer, unsigned nframes)
+{
+	const unsigned silentFrames = mSilentFrames;
+	if (!IsIdle())
+		Process(buffer, nframes);
+	mSilentFrames = std::min(silentFrames + nframes, getTailFrames());
+}
+
 void
 Distortion::Process	(float *buffer, unsigned nframes)
 {
-	float x, s;
-	for (unsigned i=0; i<nframes; i++)
-	{
-		x = buffer[i];
-		if(x<0) s=-1; else s=1;
-		x*=s;
-		float c = crunch.tick();
-		x = pow (x, c < 0.01f ? 0.01f : c);
-		buffer[i] = x*s;
+	mSilentFrames = 0;
+
+	if (crunch.settle(kSettledTolerance)) {
+		const float c = std::max(crunch.getRawValue(), kMinExponent);
+		if (c < 1.f) {
+			if (c != mTableCrunch)
+				buildTable(c);
+			run(buffer, nframes, [this](float x, unsigned) { return lookup(x); });
+		} else if (mOversampler.getFactor() > 1) {
+			run(buffer, nframes, [](float x, unsigned) { return x; });
+		}
+		return;
+	}
+
+	// While the crunch is moving the curve is computed directly
+	static constexpr unsigned kChunkSize = 64;
+	float c[kChunkSize];
+	for (unsigned offset = 0; offset < nframes; offset += kChunkSize) {
+		const unsigned n = std::min(nframes - offset, kChunkSize);
+		for (unsigned i = 0; i < n; i++)
+			c[i] = std::max(crunch.tick(), kMinExponent);
+		run(buffer + offset, n, [&c](float x, unsigned i) { return shape(x, c[i]); });
+	}
+}
+
+template <typename Shaper>
+void
+Distortion::run	(float *buffer, unsigned nframes, Shaper shaper)
+{
+	const int factor = mOversampler.getFactor();
+	if (factor == 1) {
+		for (unsigned i = 0; i < nframes; i++)
+			buffer[i] = shaper(buffer[i], i);
+		return;
+	}
+
+	float samples[kMaxOversampling];
+	for (unsigned i = 0; i < nframes; i++) {
+		mOversampler.upsample(buffer[i], samples);
+		for (int j = 0; j < factor; j++)
+			samples[j] = shaper(samples[j], i);
+		buffer[i] = mOversampler.downsample(samples);
 	}
 }
+
+void
+Distortion::buildTable	(float c)
+{
+	for (int i = 0; i <= kTableSize; i++) {
+		const float x = ldexpf(1.f + (float)(i % kTableSegments) / kTableSegments, kTableMinExponent + i / kTableSegments);
+		mTable[i] = powf(x, c);
+	}
+	mTableCrunch = c;
+}
+
+float
+Distortion::lookup	(float x) const
+{
+	const float kTableMin = ldexpf(1.f, kTableMinExponent);
+	const float a = std::fabs(x);
+	float y;
+	if (a < kTableMin) {
+		// fade out linearly below the table rather than amplifying noise
+		y = mTable[0] * a / kTableMin;
+	} else {
+		// the exponent and leading mantissa bits of a give the segment, and
+		// the rest of the mantissa the position within it
+		const int kFractionBits = 23 - kTableSegmentBits;
+		int32_t bits;
+		memcpy(&bits, &a, sizeof bits);
+		const int32_t offset = bits - ((127 + kTableMinExponent) << 23);
+		const int32_t index = offset >> kFractionBits;
+		if (index >= kTableSize) {
+			y = mTable[kTableSize];
+		} else {
+			const float frac = (float)(offset & ((1 << kFractionBits) - 1)) * (1.f / (1 << kFractionBits));
+			y = mTable[index] + frac * (mTable[index + 1] - mTable[index]);
+		}
+	}
+	return std::copysign(y, x);
+}
+
+void
+Distortion::Oversampler::setFactor	(int factor)
+{
+	mFactor = factor;
+
+	// Blackman windowed sinc, cut off at 80% of the original Nyquist
+	// frequency, and normalized for unity gain at DC
+	const int taps = kTapsPerPhase * factor;
+	const double cutoff = 0.4 / factor;
+	double sum = 0;
+	for (int i = 0; i < taps; i++) {
+		const double t = i - (taps - 1) / 2.0;
+		const double sinc = t == 0 ? 2 * cutoff : sin(2 * M_PI * cutoff * t) / (M_PI * t);
+		const double window = 0.42 - 0.5 * cos(2 * M_PI * i / (taps - 1)) + 0.08 * cos(4 * M_PI * i / (taps - 1));
+		mCoefficients[i] = (float)(sinc * window);
+		sum += mCoefficients[i];
+	}
+	for (int i = 0; i < taps; i++)
+		mCoefficients[i] = (float)(mCoefficients[i] / sum);
+
+	reset();
+}
+
+void
+Distortion::Oversampler::reset	()
+{
+	memset(mInput, 0, sizeof(mInput));
+	memset(mOutput, 0, sizeof(mOutput));
+	mInputPos = 0;
+	mOutputPos = 0;
+}
+
+void
+Distortion::Oversampler::upsample	(float in, float *out)
+{
+	mInputPos = (mInputPos + kTapsPerPhase - 1) % kTapsPerPhase;
+	mInput[mInputPos] = mInput[mInputPos + kTapsPerPhase] = in;
+
+	// The zero-stuffed input only meets every mFactor'th coefficient
+	const float *history = mInput + mInputPos;
+	for (int k = 0; k < mFactor; k++) {
+		float sum = 0;
+		for (int m = 0; m < kTapsPerPhase; m++)
+			sum += mCoefficients[k + m * mFactor] * history[m];
+		out[k] = sum * mFactor;
+	}
+}
+
+float
+Distortion::Oversampler::downsample	(const float *in)
+{
+	const int taps = kTapsPerPhase * mFactor;
+	for (int k = 0; k < mFactor; k++) {
+		mOutputPos = (mOutputPos + taps - 1) % taps;
+		mOutput[mOutputPos] = mOutput[mOutputPos + taps] = in[k];
+	}
+
+	const float *history = mOutput + mOutputPos;
+	float sum = 0;
+	for (int i = 0; i < taps; i++)
+		sum += mCoefficients[i] * history[i];
+	return sum;
+}
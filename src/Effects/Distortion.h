@@ -1,7 +1,7 @@
 /*
  *  Distortion.h
  *
- *  Copyright (c) 2001-2012 Nick Dowell
+ *  Copyright (c) 2001-2022 Nick Dowell
  *
  *  This file is part of amsynth.
  *
@@ -26,14 +26,87 @@
 
 /**
  * @brief A distortion (waveshaping) effect unit
+ *
+ * The transfer curve is sign(x) |x|^c, with c = 1 - crunch. At a crunch of
+ * 0 the curve is the identity and the unit is bypassed. Otherwise,
+ * once the crunch has stopped moving, the curve is read from a table that
+ * is rebuilt whenever the crunch changes.
  */
 class Distortion
 {
 public:
+	static constexpr int kMaxOversampling = 4;
+
 	void	SetCrunch		(float);
+
+	/**
+	 * Runs the waveshaper at 1, 2 or 4 times the sample rate (other values
+	 * are rounded down), to reduce the aliasing of heavy settings.
+	 * Oversampling delays the signal by kTapsPerPhase samples, so to keep
+	 * that constant the filters keep running (and the unit is never
+	 * bypassed) while it is enabled.
+	 */
+	void	SetOversampling	(int factor);
+	int		GetOversampling	() const { return mOversampler.getFactor(); }
+
 	void	Process			(float *buffer, unsigned);
+
+	/**
+	 * Equivalent to Process() on a buffer of silence, which only has any
+	 * effect while the oversampling filters are emptying.
+	 */
+	void	ProcessSilence	(float *buffer, unsigned);
+
+	/** @return true if ProcessSilence() currently has nothing to do */
+	bool	IsIdle			() const { return mSilentFrames >= getTailFrames(); }
+
 private:
+	static constexpr int kTapsPerPhase = 32;
+
+	// Polyphase FIR interpolator and decimator sharing one windowed-sinc
+	// low pass filter
+	class Oversampler
+	{
+	public:
+		void	setFactor	(int factor);
+		int		getFactor	() const { return mFactor; }
+		void	reset		();
+		void	upsample	(float in, float *out);
+		float	downsample	(const float *in);
+
+	private:
+		int		mFactor = 1;
+		float	mCoefficients[kTapsPerPhase * kMaxOversampling] = {};
+		// Each history is stored twice over, so that the last N samples are
+		// always contiguous, newest first
+		float	mInput[kTapsPerPhase * 2] = {};
+		float	mOutput[kTapsPerPhase * kMaxOversampling * 2] = {};
+		int		mInputPos = 0;
+		int		mOutputPos = 0;
+	};
+
+	// Silent input takes this many frames to clear the filters
+	unsigned	getTailFrames	() const { return mOversampler.getFactor() > 1 ? kTapsPerPhase * 2 : 0; }
+
+	template <typename Shaper>
+	void	run				(float *buffer, unsigned nframes, Shaper);
+	void	buildTable		(float c);
+	float	lookup			(float x) const;
+
+	// The table covers |x| from 2^kTableMinExponent up to 2^kTableMaxExponent
+	// in kTableSegments linear segments per octave; following the float
+	// format keeps the segments short where the curve bends most
+	static constexpr int kTableMinExponent = -24;
+	static constexpr int kTableMaxExponent = 8;
+	static constexpr int kTableSegmentBits = 5;
+	static constexpr int kTableSegments = 1 << kTableSegmentBits;
+	static constexpr int kTableSize = (kTableMaxExponent - kTableMinExponent) * kTableSegments;
+
 	SmoothedParam crunch{1};
+	float	mTableCrunch = 1;
+	float	mTable[kTableSize + 1];
+	Oversampler mOversampler;
+	unsigned	mSilentFrames = 0;
 };
 
 #endif
@@ -1,7 +1,7 @@
 /*
  *  SoftLimiter.cpp
  *
- *  Copyright (c) 2001-2012 Nick Dowell
+ *  Copyright (c) 2001-2022 Nick Dowell
  *
  *  This file is part of amsynth.
  *
@@ -20,55 +20,146 @@
  */
 
 #include "SoftLimiter.h"
-#include <math.h>
-#include <iostream>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
 
 #define AT 0.0001		// attack time in seconds
 #define RT 0.5			// release time in seconds
 #define THRESHOLD 0.9	// THRESHOLD>0 !!
 
+constexpr int SoftLimiter::kMaxLookahead;
+
 void
 SoftLimiter::SetSampleRate	(int rate)
 {
+	this->rate = rate;
 	xpeak=0;
 	attack=1-exp(-2.2/(AT*(float)rate));
 	release=1-exp(-2.2/(RT*(float)rate));
-	thresh=(float)log(THRESHOLD); // thresh in linear scale :)
+	threshold=THRESHOLD;
+	SetLookahead(mLookaheadSeconds);
+}
+
+void
+SoftLimiter::SetLookahead	(float seconds)
+{
+	mLookaheadSeconds = seconds;
+	mLookahead = std::min(std::max((int) lrintf(seconds * rate), 0), kMaxLookahead);
+	resetLookahead();
+}
+
+void
+SoftLimiter::resetLookahead	()
+{
+	memset(mDelayL, 0, sizeof(mDelayL));
+	memset(mDelayR, 0, sizeof(mDelayR));
+	mDelayPos = 0;
+	mHoldFront = 0;
+	mHoldCount = 0;
+}
+
+float
+SoftLimiter::holdPeak	(float envelope)
+{
+	const int capacity = kMaxLookahead + 1;
+
+	// The front falls out of the window eventually, and goes first so that
+	// the deque never holds more than the window's mLookahead + 1 frames
+	if (mHoldCount > 0 && mFrame - mHoldFrames[mHoldFront] > (uint32_t) mLookahead) {
+		mHoldFront = (mHoldFront + 1) % capacity;
+		mHoldCount--;
+	}
+
+	// Values that are no larger than the new one can never be the maximum again
+	while (mHoldCount > 0 && mHoldValues[(mHoldFront + mHoldCount - 1) % capacity] <= envelope)
+		mHoldCount--;
+	assert(mHoldCount < capacity);
+	const int back = (mHoldFront + mHoldCount) % capacity;
+	mHoldValues[back] = envelope;
+	mHoldFrames[back] = mFrame;
+	mHoldCount++;
+
+	mFrame++;
+	return mHoldValues[mHoldFront];
 }
 
 void
 SoftLimiter::Process	(float *l, float *r, unsigned nframes, int stride)
 {
-	double x;
-	unsigned i;
-	for (i=0; i<nframes; i++)
-	{
-		x = fabs(*l) + fabs (*r);
-		
-		if (x>xpeak) xpeak=(1-release)*xpeak + attack*(x-xpeak);
-		else xpeak=(1-release)*xpeak;
-			
-		if (xpeak>0){
-//			x = 1/xpeak;
-			x = log(xpeak);
-			x -= thresh;
-			if (x<0) x = 0;
-//			x *= ((1/Ratio)-1); 
-			/* 1<= Ratio < infinity = compressor
-			   ratio=infinity = limiter
-			   0 < ratio < 1 = expander
-			   0 = gate
-			*/
-			else x *= -1;
-			x = exp(x);
-		} else x=1;
-		
-		// apply gain
-		*l *= x;
-		*r *= x;
-		
-		// Increment sample pointers, allowing for interleave (if any)
-		l += stride;
-		r += stride;
+	static constexpr unsigned kChunkSize = 64;
+	float envelope[kChunkSize];
+
+	mSilentFrames = 0;
+
+	for (unsigned offset = 0; offset < nframes; offset += kChunkSize) {
+		const unsigned n = std::min(nframes - offset, kChunkSize);
+		float *lc = l + offset * stride;
+		float *rc = r + offset * stride;
+
+		// The envelope is recursive, so this loop can't be vectorized...
+		float peak = 0;
+		for (unsigned i = 0; i < n; i++) {
+			const double x = fabsf(lc[i * stride]) + fabsf(rc[i * stride]);
+			if (x>xpeak) xpeak=(1-release)*xpeak + attack*(x-xpeak);
+			else xpeak=(1-release)*xpeak;
+			envelope[i] = (float)xpeak;
+			peak = std::max(peak, envelope[i]);
+		}
+
+		if (mLookahead > 0) {
+			peak = 0;
+			for (unsigned i = 0; i < n; i++) {
+				envelope[i] = holdPeak(envelope[i]);
+				peak = std::max(peak, envelope[i]);
+				std::swap(lc[i * stride], mDelayL[mDelayPos]);
+				std::swap(rc[i * stride], mDelayR[mDelayPos]);
+				mDelayPos = mDelayPos + 1 < mLookahead ? mDelayPos + 1 : 0;
+			}
+		}
+
+		// ...but there is nothing more to do until the threshold is crossed
+		if (peak <= threshold)
+			continue;
+
+		// threshold / envelope above the threshold, 1 below it
+		for (unsigned i = 0; i < n; i++)
+			envelope[i] = threshold / std::max(envelope[i], threshold);
+
+		if (stride == 1) {
+			for (unsigned i = 0; i < n; i++) {
+				lc[i] *= envelope[i];
+				rc[i] *= envelope[i];
+			}
+		} else {
+			for (unsigned i = 0; i < n; i++) {
+				lc[i * stride] *= envelope[i];
+				rc[i * stride] *= envelope[i];
+			}
+		}
+	}
+}
+
+bool
+SoftLimiter::IsIdle	() const
+{
+	return mSilentFrames >= (unsigned) mLookahead && xpeak <= threshold &&
+		(mHoldCount == 0 || mHoldValues[mHoldFront] <= threshold);
+}
+
+void
+SoftLimiter::ProcessSilence	(float *l, float *r, unsigned nframes, int stride)
+{
+	const unsigned silentFrames = mSilentFrames;
+	if (IsIdle()) {
+		xpeak *= pow(1 - release, nframes);
+		// The held values are all below the threshold, where they have no
+		// effect on the gain, as are all the values skipped over
+		mHoldCount = 0;
+	} else {
+		Process(l, r, nframes, stride);
 	}
+	mSilentFrames = std::min(silentFrames + nframes, (unsigned) kMaxLookahead);
 }
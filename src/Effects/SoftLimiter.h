@@ -1,7 +1,7 @@
 /*
  *  SoftLimiter.h
  *
- *  Copyright (c) 2001-2012 Nick Dowell
+ *  Copyright (c) 2001-2022 Nick Dowell
  *
  *  This file is part of amsynth.
  *
@@ -22,13 +22,67 @@
 #ifndef _SOFTLIMITER_H
 #define _SOFTLIMITER_H
 
+#include <cstdint>
+
+/**
+ * Keeps the peak level of the stereo output at or below a fixed threshold.
+ *
+ * The envelope follows |l| + |r| in the linear domain, and the gain is only
+ * reduced when the envelope is above the threshold. The ratio is infinite,
+ * so the gain is simply threshold / envelope.
+ */
 class SoftLimiter
 {
 public:
+	static constexpr int kMaxLookahead = 256;
+
 	void	SetSampleRate	(int rate);
+
+	/**
+	 * Delays the output by up to kMaxLookahead frames, so that the gain has
+	 * already come down when a transient arrives rather than shortly after.
+	 * 0 (the default) disables the lookahead. Must not be called
+	 * concurrently with Process().
+	 */
+	void	SetLookahead	(float seconds);
+	int		GetLookaheadFrames	() const { return mLookahead; }
+
 	void	Process	(float *l, float *r, unsigned, int stride=1);
+
+	/**
+	 * Equivalent to Process() on a buffer of silence. Once the lookahead
+	 * delay holds nothing but silence and the gain is no longer reduced, the
+	 * output is silent whatever the envelope does, so only the envelope's
+	 * decay is computed and the buffer is left untouched.
+	 */
+	void	ProcessSilence	(float *l, float *r, unsigned, int stride=1);
+
+	/** @return true if ProcessSilence() currently has nothing to do */
+	bool	IsIdle	() const;
+
   private:
-	double xpeak, attack, release, thresh;
+	void	resetLookahead	();
+	float	holdPeak		(float envelope);
+
+	double xpeak = 0, attack = 0, release = 0;
+	float threshold = 0;
+	int rate = 44100;
+
+	float mLookaheadSeconds = 0;
+	int mLookahead = 0;
+	float mDelayL[kMaxLookahead] = {};
+	float mDelayR[kMaxLookahead] = {};
+	int mDelayPos = 0;
+
+	// The maximum of the envelope over the last mLookahead + 1 frames, kept
+	// as a deque of decreasing values (with the frame each was seen at)
+	float mHoldValues[kMaxLookahead + 1];
+	uint32_t mHoldFrames[kMaxLookahead + 1];
+	int mHoldFront = 0, mHoldCount = 0;
+	uint32_t mFrame = 0;
+
+	// Frames of silent input since the last call to Process()
+	unsigned mSilentFrames = 0;
 };
 
 #endif
@@ -71,6 +71,7 @@ protected:
     void _AmsynthControl_FilterSlope();
 
     void _AmsynthControl_LFOOscillatorSelect();
+    void _AmsynthControl_LFOMode(); // per voice or global
 
     void _AmsynthControl_FilterKeyTrackAmount();
     void _AmsynthControl_FilterKeyVelocityAmount();
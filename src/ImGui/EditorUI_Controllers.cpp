@@ -216,6 +216,19 @@ void EditorUI::_AmsynthControl_LFOOscillatorSelect()
     }
 }
 
+void EditorUI::_AmsynthControl_LFOMode()
+{
+    const int LFO_MODE_COUNT = 2;
+    const char* lfo_modeOptions[LFO_MODE_COUNT] = { "Per Voice", "Global" };
+
+    if (ImGui::ComboButton("LFO Mode", fUI->fParamValues[kAmsynthParameter_LFOMode], lfo_modeOptions, LFO_MODE_COUNT,
+            ImVec2(80, 0), "LFO Mode")) {
+        EDIT_PARAM_ON(kAmsynthParameter_LFOMode);
+        SET_PARAM_VALUE(kAmsynthParameter_LFOMode);
+        EDIT_PARAM_OFF(kAmsynthParameter_LFOMode);
+    }
+}
+
 void EditorUI::_AmsynthControl_LFOFreq()
 {
     _insertKnob("Frequency", kAmsynthParameter_LFOFreq);
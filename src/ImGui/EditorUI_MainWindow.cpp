@@ -172,6 +172,9 @@ void EditorUI::amsynthWindow_Main()
             // LFO OSC selector
             ImGui::Text("Apply to → ");
             _AmsynthControl_LFOOscillatorSelect();
+            ImGui::SameLine(0, 40);
+
+            _AmsynthControl_LFOMode();
 
             ImGui::EndMenuBar();
         }
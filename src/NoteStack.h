@@ -0,0 +1,139 @@
+/*
+ *  NoteStack.h
+ *
+ *  Copyright (c) 2022 Nick Dowell
+ *
+ *  This file is part of amsynth.
+ *
+ *  amsynth is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  amsynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with amsynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _NOTESTACK_H
+#define _NOTESTACK_H
+
+#include "controls.h"
+
+#include <cassert>
+#include <stdint.h>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+/**
+ * The set of MIDI notes being held, in the order they were pressed, with
+ * constant time push, remove and lookup of the note to play by any
+ * NotePriority.
+ *
+ * The press order is an intrusive doubly-linked list through the notes, and
+ * a bitmask of the notes finds the lowest and highest.
+ */
+class NoteStack
+{
+public:
+	NoteStack() { clear(); }
+
+	void	clear()
+	{
+		for (int i = 0; i < kWords; i++)
+			_bits[i] = 0;
+		_top = -1;
+		_size = 0;
+	}
+
+	bool		empty()		const { return _top < 0; }
+	unsigned	size()		const { return _size; }
+
+	bool	contains(int note) const
+	{
+		assert(0 <= note && note < 128);
+		return (_bits[note >> 5] >> (note & 31)) & 1;
+	}
+
+	/** Adds note as the most recent, moving it there if already held */
+	void	push(int note)
+	{
+		remove(note);
+		_below[note] = _top;
+		_above[note] = -1;
+		if (_top >= 0)
+			_above[_top] = note;
+		_top = note;
+		_bits[note >> 5] |= 1u << (note & 31);
+		_size++;
+	}
+
+	void	remove(int note)
+	{
+		if (!contains(note))
+			return;
+		if (_above[note] >= 0)
+			_below[_above[note]] = _below[note];
+		else
+			_top = _below[note];
+		if (_below[note] >= 0)
+			_above[_below[note]] = _above[note];
+		_bits[note >> 5] &= ~(1u << (note & 31));
+		_size--;
+	}
+
+	/** @return the note to play, or -1 if none are held */
+	int		select(NotePriority priority) const
+	{
+		switch (priority) {
+		case NotePriorityLow:
+			for (int i = 0; i < kWords; i++)
+				if (_bits[i])
+					return (i << 5) + lowestBit(_bits[i]);
+			return -1;
+		case NotePriorityHigh:
+			for (int i = kWords - 1; i >= 0; i--)
+				if (_bits[i])
+					return (i << 5) + highestBit(_bits[i]);
+			return -1;
+		default:
+			return _top;
+		}
+	}
+
+private:
+	static constexpr int kWords = 128 / 32;
+
+	static int	lowestBit(uint32_t x)
+	{
+#if defined(_MSC_VER)
+		unsigned long i; _BitScanForward(&i, x); return (int) i;
+#else
+		return __builtin_ctz(x);
+#endif
+	}
+
+	static int	highestBit(uint32_t x)
+	{
+#if defined(_MSC_VER)
+		unsigned long i; _BitScanReverse(&i, x); return (int) i;
+#else
+		return 31 - __builtin_clz(x);
+#endif
+	}
+
+	uint32_t	_bits[kWords];
+	int			_top; // the most recently pushed note
+	unsigned	_size;
+	// Only meaningful for the notes contained
+	int8_t		_above[128];
+	int8_t		_below[128];
+};
+
+#endif
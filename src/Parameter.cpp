@@ -83,6 +83,7 @@ static const ParameterSpec ParameterSpecs[] = { //                            de
 	SPEC(kAmsynthParameter_FilterKeyVelocityAmount, "filter_vel_sens",       1.0f,   0.0f,   1.0f,  0.0f,       kParameterLaw_Linear,        1.0f,  0.0f,       ""   ),
 	SPEC(kAmsynthParameter_AmpVelocityAmount,       "amp_vel_sens",          1.0f,   0.0f,   1.0f,  0.0f,       kParameterLaw_Linear,        1.0f,  0.0f,       ""   ),
 	SPEC(kAmsynthParameter_PortamentoMode,          "portamento_mode",       0.0f,   0.0f,   1.0f,  0.0f,       kParameterLaw_Linear,        1.0f,  0.0f,       ""   ),
+	SPEC(kAmsynthParameter_LFOMode,                 "lfo_mode",              0.0f,   0.0f,   1.0f,  1.0f,       kParameterLaw_Linear,        1.0f,  0.0f,       ""   ),
 };
 
 static float getControlValue(const ParameterSpec &spec, float value)
@@ -274,6 +275,7 @@ int parameter_get_display(int param_index, float value, char *buffer, size_t max
 		case kAmsynthParameter_FilterSlope:
 		case kAmsynthParameter_LFOOscillatorSelect:
 		case kAmsynthParameter_PortamentoMode:
+		case kAmsynthParameter_LFOMode:
 			return 0;
 		case kAmsynthParameterCount:
 		default:
@@ -355,6 +357,13 @@ const char **parameter_get_value_strings(int param_index)
 				assert(i < size);
 				break;
 
+			case kAmsynthParameter_LFOMode:
+				strings.resize(size = 3);
+				strings[i++] = _("per voice");
+				strings[i++] = _("global");
+				assert(i < size);
+				break;
+
 			default:
 				break;
 		}
@@ -21,15 +21,17 @@
 
 #include "Synthesizer.h"
 
+#include "DenormalGuard.h"
 #include "MidiController.h"
 #include "PresetController.h"
 #include "VoiceAllocationUnit.h"
-#include "VoiceBoard/VoiceBoard.h"
+#include "VoiceBoard/Wavetable.h"
 
 #include <algorithm>
 #include <cassert>
 #include <cstdio>
 #include <cstring>
+#include <limits>
 
 
 Synthesizer::Synthesizer()
@@ -41,6 +43,8 @@ Synthesizer::Synthesizer()
 	_voiceAllocationUnit = new VoiceAllocationUnit;
 	_voiceAllocationUnit->SetSampleRate((int) _sampleRate);
 
+	std::fill_n(lastParameterValues_, kAmsynthParameterCount, std::numeric_limits<float>::quiet_NaN());
+
 	_presetController = new PresetController;
 	_presetController->getCurrentPreset().AddListenerToAll(_voiceAllocationUnit);
 	
@@ -54,6 +58,8 @@ Synthesizer::~Synthesizer()
 	delete _midiController;
 	delete _presetController;
 	delete _voiceAllocationUnit;
+	delete pendingVoicePool_.load();
+	deleteRetiredVoicePools();
 }
 
 void Synthesizer::loadBank(const char *filename)
@@ -136,6 +142,16 @@ void Synthesizer::setParameterValue(Param parameter, float value)
 	_presetController->getCurrentPreset().getParameter(parameter).setValue(value);
 }
 
+void Synthesizer::setParameterValues(const float *const values[kAmsynthParameterCount])
+{
+	for (int i = 0; i < kAmsynthParameterCount; i++) {
+		if (values[i] && lastParameterValues_[i] != *values[i]) {
+			lastParameterValues_[i] = *values[i];
+			_presetController->getCurrentPreset().getParameter(i).setValue(*values[i]);
+		}
+	}
+}
+
 void Synthesizer::setNormalizedParameterValue(Param parameter, float value)
 {
 	_presetController->getCurrentPreset().getParameter(parameter).setNormalisedValue(value);
@@ -163,12 +179,121 @@ void Synthesizer::setPitchBendRangeSemitones(int value)
 
 int Synthesizer::getMaxNumVoices()
 {
-	return _voiceAllocationUnit->GetMaxVoices();
+	const int pending = pendingMaxNumVoices_;
+	return pending >= 0 ? pending : _voiceAllocationUnit->GetMaxVoices();
 }
 
 void Synthesizer::setMaxNumVoices(int value)
 {
-	_voiceAllocationUnit->SetMaxVoices(value);
+	if (processing_) {
+		deleteRetiredVoicePools();
+		pendingMaxNumVoices_ = value;
+		delete pendingVoicePool_.exchange(_voiceAllocationUnit->CreateVoicePool(value));
+	} else {
+		_voiceAllocationUnit->SetMaxVoices(value);
+	}
+}
+
+void Synthesizer::deleteRetiredVoicePools()
+{
+	VoicePool *pool = retiredVoicePools_.exchange(nullptr);
+	while (pool) {
+		VoicePool *next = pool->next;
+		delete pool;
+		pool = next;
+	}
+}
+
+int Synthesizer::getBlockSize()
+{
+	return _voiceAllocationUnit->GetBlockSize();
+}
+
+void Synthesizer::setBlockSize(int frames)
+{
+	_voiceAllocationUnit->SetBlockSize(frames);
+}
+
+int Synthesizer::getRenderThreads()
+{
+	return _voiceAllocationUnit->GetRenderThreads();
+}
+
+void Synthesizer::setRenderThreads(int value)
+{
+	_voiceAllocationUnit->SetRenderThreads(value);
+}
+
+bool Synthesizer::getBandLimitedOscillators()
+{
+	return _voiceAllocationUnit->GetBandLimitedOscillators();
+}
+
+void Synthesizer::setBandLimitedOscillators(bool enabled)
+{
+	if (enabled)
+		Wavetable::prepare();
+	_voiceAllocationUnit->SetBandLimitedOscillators(enabled);
+}
+
+bool Synthesizer::getSVFFilter()
+{
+	return _voiceAllocationUnit->GetSVFFilter();
+}
+
+void Synthesizer::setSVFFilter(bool enabled)
+{
+	_voiceAllocationUnit->SetSVFFilter(enabled);
+}
+
+int Synthesizer::getControlPeriod()
+{
+	return _voiceAllocationUnit->GetControlPeriod();
+}
+
+void Synthesizer::setControlPeriod(int samples)
+{
+	_voiceAllocationUnit->SetControlPeriod(samples);
+}
+
+unsigned Synthesizer::getRandomSeed()
+{
+	return _voiceAllocationUnit->GetRandomSeed();
+}
+
+void Synthesizer::setRandomSeed(unsigned seed)
+{
+	_voiceAllocationUnit->SetRandomSeed(seed);
+}
+
+int Synthesizer::getDistortionOversampling()
+{
+	return _voiceAllocationUnit->GetDistortionOversampling();
+}
+
+void Synthesizer::setDistortionOversampling(int factor)
+{
+	_voiceAllocationUnit->SetDistortionOversampling(factor);
+}
+
+void Synthesizer::setLimiterLookahead(float seconds)
+{
+	_voiceAllocationUnit->SetLimiterLookahead(seconds);
+}
+
+NotePriority Synthesizer::getNotePriority()
+{
+	return _voiceAllocationUnit->GetNotePriority();
+}
+
+void Synthesizer::setNotePriority(NotePriority priority)
+{
+	_voiceAllocationUnit->SetNotePriority(priority);
+}
+
+bool Synthesizer::isSilent()
+{
+	return _voiceAllocationUnit->IsIdle();
 }
 
 unsigned char Synthesizer::getMidiChannel()
@@ -210,6 +335,25 @@ void Synthesizer::setSampleRate(int sampleRate)
 	_voiceAllocationUnit->SetSampleRate(sampleRate);
 }
 
+void Synthesizer::prepareToProcess()
+{
+	processing_ = true;
+	if (pendingVoicePool_) {
+		VoicePool *pool = pendingVoicePool_.exchange(nullptr);
+		if (pool) {
+			VoicePool *retired = _voiceAllocationUnit->SwapVoicePool(pool);
+			retired->next = retiredVoicePools_.load();
+			while (!retiredVoicePools_.compare_exchange_weak(retired->next, retired)) {}
+			int maxNumVoices = _voiceAllocationUnit->GetMaxVoices();
+			pendingMaxNumVoices_.compare_exchange_strong(maxNumVoices, -1);
+		}
+	}
+	if (needsResetAllVoices_) {
+		needsResetAllVoices_ = false;
+		_voiceAllocationUnit->resetAllVoices();
+	}
+}
+
 void Synthesizer::process(unsigned int nframes,
 						  const std::vector<amsynth_midi_event_t> &midi_in,
 						  std::vector<amsynth_midi_cc_t> &midi_out,
@@ -219,11 +363,16 @@ void Synthesizer::process(unsigned int nframes,
 		assert(nullptr == "sample rate has not been set");
 		return;
 	}
-	if (needsResetAllVoices_) {
-		needsResetAllVoices_ = false;
-		_voiceAllocationUnit->resetAllVoices();
+	DenormalGuard denormalGuard;
+	prepareToProcess();
+	if (midi_in.empty() && _voiceAllocationUnit->IsIdle()) {
+		// Nothing will sound, so there's no need to split the buffer up
+		_voiceAllocationUnit->Process(audio_l, audio_r, nframes, audio_stride);
+		_midiController->generateMidiOutput(midi_out);
+		return;
 	}
 	std::vector<amsynth_midi_event_t>::const_iterator event = midi_in.begin();
+	const unsigned max_block_size = (unsigned)_voiceAllocationUnit->GetBlockSize();
 	unsigned frames_left_in_buffer = nframes, frame_index = 0;
 	while (frames_left_in_buffer) {
 		while (event != midi_in.end() && event->offset_frames <= frame_index) {
@@ -231,7 +380,7 @@ void Synthesizer::process(unsigned int nframes,
 			++event;
 		}
 		
-		unsigned block_size_frames = std::min(frames_left_in_buffer, (unsigned)VoiceBoard::kMaxProcessBufferSize);
+		unsigned block_size_frames = std::min(frames_left_in_buffer, max_block_size);
 		if (event != midi_in.end() && event->offset_frames > frame_index) {
 			unsigned frames_until_next_event = event->offset_frames - frame_index;
 			block_size_frames = std::min(block_size_frames, frames_until_next_event);
@@ -25,6 +25,7 @@
 #include "types.h"
 #include "controls.h"
 
+#include <atomic>
 #include <vector>
 
 //
@@ -37,6 +38,7 @@
 class MidiController;
 class PresetController;
 class VoiceAllocationUnit;
+struct VoicePool;
 
 struct ISynthesizer
 {
@@ -65,6 +67,11 @@ public:
     float getParameterValue(Param parameter);
     void setParameterValue(Param parameter, float value);
 
+    // Updates every parameter whose values[parameter] changed since the last
+    // call (all of them on the first), skipping null entries. Intended for
+    // plugin wrappers with one port per parameter, called every block.
+    void setParameterValues(const float *const values[kAmsynthParameterCount]);
+
     float getNormalizedParameterValue(Param parameter);
     void setNormalizedParameterValue(Param parameter, float value);
 
@@ -74,9 +81,63 @@ public:
 
     void setPitchBendRangeSemitones(int value);
 
+	// Resizing the voice pool can't happen while voices are being rendered,
+	// so once processing has started it is deferred to the next process().
 	int getMaxNumVoices();
 	void setMaxNumVoices(int value);
 
+	// Maximum number of frames rendered per internal processing block.
+	// Must not be called while process() is running.
+	int getBlockSize();
+	void setBlockSize(int frames);
+
+	// Number of threads used to render voices, including the audio thread.
+	// Must not be called while process() is running.
+	int getRenderThreads();
+	void setRenderThreads(int value);
+
+	// Render the oscillators from band-limited wavetables (off by default,
+	// so existing patches sound the same). Safe to call at any time from
+	// the same thread as process().
+	bool getBandLimitedOscillators();
+	void setBandLimitedOscillators(bool enabled);
+
+	// Modulate the voice filters' cutoff every sample rather than once per
+	// block (off by default, as it changes the sound).
+	// Safe to call at any time from the same thread as process().
+	bool getSVFFilter();
+	void setSVFFilter(bool enabled);
+
+	// Samples between updates of the LFO and filter envelope, which are
+	// ramped in between. 1 (the default) updates them every sample.
+	// Safe to call at any time from the same thread as process().
+	int getControlPeriod();
+	void setControlPeriod(int samples);
+
+	// Seed for the noise generators. Renders are repeatable for a given
+	// seed; must not be called while process() is running.
+	unsigned getRandomSeed();
+	void setRandomSeed(unsigned seed);
+
+	// Oversampling factor (1, 2 or 4) for the distortion effect.
+	// Must not be called while process() is running.
+	int getDistortionOversampling();
+	void setDistortionOversampling(int factor);
+
+	// Output limiter lookahead, adding up to a few milliseconds of latency
+	// so that transients are caught. Must not be called while process() is
+	// running.
+	void setLimiterLookahead(float seconds);
+
+	// Which held note sounds in mono and legato modes (the last pressed by
+	// default). Must not be called while process() is running.
+	NotePriority getNotePriority();
+	void setNotePriority(NotePriority priority);
+
+	// True if nothing is sounding and the output will stay silent until the
+	// next note, for hosts that can skip processing a silent plugin
+	bool isSilent();
+
 	static constexpr unsigned char kMidiChannel_Any = 0;
 	unsigned char getMidiChannel();
 	void setMidiChannel(unsigned char);
@@ -97,6 +158,13 @@ public:
     bool getIfNeedsResetAllVoices() { return needsResetAllVoices_; }
     void setIfNeedsResetAllVoices(bool value) { needsResetAllVoices_ = value; }
 
+protected:
+
+    // Applies changes deferred to the audio thread; called at the start of process()
+    void prepareToProcess();
+
+public:
+
 // private:
 
     double _sampleRate;
@@ -107,6 +175,17 @@ public:
 private:
 
 	bool needsResetAllVoices_ = false;
+	std::atomic<bool> processing_{false};
+	std::atomic<int> pendingMaxNumVoices_{-1};
+	// The values last passed to setParameterValues, kept contiguous so an
+	// unchanged block is checked without touching the Parameter objects
+	float lastParameterValues_[kAmsynthParameterCount];
+	// Voices for a polyphony change made while processing, allocated by the
+	// caller and swapped in by the audio thread, which pushes the old ones
+	// onto the retired list for the caller to delete
+	std::atomic<VoicePool *> pendingVoicePool_{nullptr};
+	std::atomic<VoicePool *> retiredVoicePools_{nullptr};
+	void deleteRetiredVoicePools();
 };
 
 #endif /* defined(__amsynth__Synthesizer__) */
@@ -21,11 +21,19 @@
 
 #include "VoiceAllocationUnit.h"
 
+#include "DenormalGuard.h"
 #include "Effects/SoftLimiter.h"
 #include "Effects/Distortion.h"
 #include "VoiceBoard/VoiceBoard.h"
+#include "VoiceRenderPool.h"
 
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
 #include <assert.h>
+#include <cstdio>
 #include <cstring>
 #include <freeverb/revmodel.hpp>
 #include <iostream>
@@ -36,54 +44,198 @@ using namespace std;
 
 const unsigned kBufferSize = 1024;
 
+constexpr int VoiceAllocationUnit::kMaxVoices;
+
+#ifdef AMSYNTH_COUNT_DENORMALS
+// Counts a block against a stage if the stage left the thread's underflow
+// flag raised (each count clears it for the next stage)
+#define COUNT_DENORMALS(stage, elsewhere) do { \
+		if (DenormalGuard::underflowed() || (elsewhere)) mDenormalBlocks[stage]++; \
+		DenormalGuard::clearUnderflow(); \
+	} while (0)
+#else
+#define COUNT_DENORMALS(stage, elsewhere) do {} while (0)
+#endif
+
 
 VoiceAllocationUnit::VoiceAllocationUnit ()
 :	mMaxVoices (0)
+,	mBlockSize (kDefaultBlockSize)
+,	mSampleRate (44100)
+,	mBandLimitedOscillators (false)
+,	mSVFFilter (false)
+,	mControlPeriod (1)
+,	mRandomSeed (0)
 ,	mPortamentoTime (0.0f)
 ,	mPortamentoMode(PortamentoModeAlways)
 ,	sustain (0)
+,	mNotePriority (NotePriorityLast)
+,	_activeHead (-1)
+,	_activeTail (-1)
+,	_activeCount (0)
+,	_sustainedCount (0)
 ,	_keyboardMode(KeyboardModePoly)
-,	mMasterVol (1.0)
+,	mRenderPool (nullptr)
 ,	mPanGainLeft(1)
 ,	mPanGainRight(1)
 ,	mPitchBendRangeSemitones(2)
 ,	mPitchBendValue(1)
 ,	mLastNoteFrequency (0.0f)
+,	mReverbIdle (true)
+,	mReverbQuietFrames (0)
+,	mDenormalBlocks ()
+,	mProcessedBlocks (0)
 {
 	limiter = new SoftLimiter;
 	reverb = new revmodel;
 	distortion = new Distortion;
 	mBuffer = new float [kBufferSize * 2];
+	mWorkspace = new VoiceBoard::Workspace;
+	mRamps = new VoiceBoard::SharedRamps;
 
-	for (int i = 0; i < 128; i++)
-	{
-		keyPressed[i] = false;
-		active[i] = false;
-		_voices.push_back (new VoiceBoard);
-	}
-	
-	memset(&_keyPresses, 0, sizeof(_keyPresses));
-
-	SetSampleRate (44100);
+	SetSampleRate (mSampleRate);
+	SetMaxVoices (mMaxVoices);
 }
 
 VoiceAllocationUnit::~VoiceAllocationUnit	()
 {
+#ifdef AMSYNTH_COUNT_DENORMALS
+	fprintf(stderr, "amsynth: denormals were flushed in %lu of %lu blocks by the voices, "
+			"%lu by the distortion, %lu by the reverb and %lu by the limiter\n",
+			mDenormalBlocks[kDenormalStageVoices], mProcessedBlocks, mDenormalBlocks[kDenormalStageDistortion],
+			mDenormalBlocks[kDenormalStageReverb], mDenormalBlocks[kDenormalStageLimiter]);
+#endif
+	delete mRenderPool;
 	while (_voices.size()) { delete _voices.back(); _voices.pop_back(); }
 	delete limiter;
 	delete reverb;
 	delete distortion;
 	delete [] mBuffer;
+	delete mWorkspace;
+	delete mRamps;
 }
 
 void
 VoiceAllocationUnit::SetSampleRate	(int rate)
 {
+	mSampleRate = rate;
 	limiter->SetSampleRate (rate);
 	for (unsigned i=0; i<_voices.size(); ++i) _voices[i]->SetSampleRate (rate);
+	mRamps->SetSampleRate (rate);
     reverb->setrate(rate);
 }
 
+static size_t
+poolSize	(int voices)
+{
+	return voices > 0 ? std::min(voices, VoiceAllocationUnit::kMaxVoices) : VoiceAllocationUnit::kMaxVoices;
+}
+
+void
+VoiceAllocationUnit::SetMaxVoices	(int voices)
+{
+	if (poolSize(voices) == _voices.size()) {
+		mMaxVoices = voices;
+		return;
+	}
+	delete SwapVoicePool (CreateVoicePool (voices));
+}
+
+VoicePool *
+VoiceAllocationUnit::CreateVoicePool	(int voices) const
+{
+	VoicePool *pool = new VoicePool;
+	pool->maxVoices = voices;
+	pool->voices.resize(poolSize(voices));
+	for (size_t i = 0; i < pool->voices.size(); i++) {
+		VoiceBoard *voice = new VoiceBoard;
+		voice->SetSampleRate (mSampleRate);
+		voice->setBandLimitedOscillators (mBandLimitedOscillators);
+		voice->setSVFFilter (mSVFFilter);
+		voice->setControlPeriod (mControlPeriod);
+		voice->setRandomSeed (mRandomSeed * kMaxVoices + (uint32_t) i);
+		pool->voices[i] = voice;
+	}
+	return pool;
+}
+
+VoicePool *
+VoiceAllocationUnit::SwapVoicePool	(VoicePool *pool)
+{
+	std::swap(_voices, pool->voices);
+	std::swap(mMaxVoices, pool->maxVoices);
+	resetAllVoices();
+	return pool;
+}
+
+void
+VoiceAllocationUnit::SetBlockSize	(int frames)
+{
+	mBlockSize = std::min(std::max(frames, 1), (int) VoiceBoard::kMaxProcessBufferSize);
+}
+
+void
+VoiceAllocationUnit::SetRenderThreads	(int threads)
+{
+	if (threads == GetRenderThreads())
+		return;
+	delete mRenderPool;
+	mRenderPool = threads > 1 ? new VoiceRenderPool (threads) : nullptr;
+}
+
+int
+VoiceAllocationUnit::GetRenderThreads	() const
+{
+	return mRenderPool ? mRenderPool->getThreadCount() : 1;
+}
+
+void
+VoiceAllocationUnit::SetBandLimitedOscillators	(bool enabled)
+{
+	mBandLimitedOscillators = enabled;
+	for (unsigned i=0; i<_voices.size(); ++i) _voices[i]->setBandLimitedOscillators (enabled);
+}
+
+void
+VoiceAllocationUnit::SetSVFFilter	(bool enabled)
+{
+	mSVFFilter = enabled;
+	for (unsigned i=0; i<_voices.size(); ++i) _voices[i]->setSVFFilter (enabled);
+}
+
+void
+VoiceAllocationUnit::SetControlPeriod	(int samples)
+{
+	mControlPeriod = std::min(std::max(samples, 1), VoiceBoard::kMaxControlPeriod);
+	for (unsigned i=0; i<_voices.size(); ++i) _voices[i]->setControlPeriod (mControlPeriod);
+}
+
+void
+VoiceAllocationUnit::SetRandomSeed	(uint32_t seed)
+{
+	mRandomSeed = seed;
+	for (unsigned i=0; i<_voices.size(); ++i) _voices[i]->setRandomSeed (seed * kMaxVoices + i);
+	mRamps->setRandomSeed (seed);
+}
+
+void
+VoiceAllocationUnit::SetDistortionOversampling	(int factor)
+{
+	distortion->SetOversampling (factor);
+}
+
+int
+VoiceAllocationUnit::GetDistortionOversampling	() const
+{
+	return distortion->GetOversampling ();
+}
+
+void
+VoiceAllocationUnit::SetLimiterLookahead	(float seconds)
+{
+	limiter->SetLookahead (seconds);
+}
+
 void
 VoiceAllocationUnit::HandleMidiNoteOn(int note, float velocity)
 {
@@ -102,93 +254,66 @@ VoiceAllocationUnit::HandleMidiNoteOn(int note, float velocity)
 	
 	float portamentoTime = mPortamentoTime;
 	if (mPortamentoMode == PortamentoModeLegato) {
-		int count = 0;
-		for (int i=0; i<128; i++) {
-			if (keyPressed[i]) {
-				count++;
-			}
-		}
-		if (count == 0) {
+		if (_pressedNotes.empty()) {
 			portamentoTime = 0;
 		}
 	}
-	
-	keyPressed[note] = true;
+
+	const int previousNote = _heldNotes.select(mNotePriority);
+	_pressedNotes.push(note);
+	_heldNotes.push(note);
 	
 	if (_keyboardMode == KeyboardModePoly) {
 
-		if (mMaxVoices) {
-			unsigned count = 0;
-			for (int i=0; i<128; i++)
-				count = count + (active[i] ? 1 : 0);
-			if (count >= (unsigned) mMaxVoices) {
-				int idx = -1;
-				// strategy 1) find the oldest voice in release phase
-				unsigned keyPress = _keyPressCounter + 1;
-				for (int i=0; i<128; i++) {
-					if (active[i] && !keyPressed[i]) {
-						if (keyPress > _keyPresses[i]) {
-							keyPress = _keyPresses[i];
-							idx = i;
-						}
-					}
-				}
-				if (idx < 0) {
-					// strategy 2) find the oldest voice
-					keyPress = _keyPressCounter + 1;
-					for (int i=0; i<128; i++) {
-						if (active[i]) {
-							if (keyPress > _keyPresses[i]) {
-								keyPress = _keyPresses[i];
-								idx = i;
-							}
-						}
-					}
-				}
-				assert(0 <= idx && idx < 128);
-				active[idx] = false;
-			}
+		// A repeated note gets a new voice, leaving the previous one to
+		// ring out in its release phase
+		if (_noteVoice[note] >= 0) {
+			VoiceBoard *previous = _voices[_noteVoice[note]];
+			previous->syncParameters(mPatch);
+			previous->triggerOff();
+			_noteVoice[note] = -1;
 		}
 
-		_keyPresses[note] = (++_keyPressCounter);
+		const int idx = allocateVoice();
+		VoiceBoard *voice = _voices[idx];
+		_voiceNote[idx] = note;
+		_noteVoice[note] = idx;
+
+		voice->syncParameters(mPatch);
 
 		if (mLastNoteFrequency > 0.0f) {
-			_voices[note]->setFrequency(mLastNoteFrequency, pitch, portamentoTime);
+			voice->setFrequency(mLastNoteFrequency, pitch, portamentoTime);
 		} else {
-			_voices[note]->setFrequency(pitch, pitch, 0);
+			voice->setFrequency(pitch, pitch, 0);
 		}
 
-		if (_voices[note]->isSilent())
-			_voices[note]->reset();
+		if (voice->isSilent())
+			voice->reset();
 		
-		_voices[note]->setVelocity(velocity);
-		_voices[note]->triggerOn(true);
+		voice->setVelocity(velocity);
+		voice->triggerOn();
 		
-		active[note] = true;
+		activateVoice(idx);
 	}
 	
 	if (_keyboardMode == KeyboardModeMono || _keyboardMode == KeyboardModeLegato) {
 
-		int previousNote = -1;
-		unsigned keyPress = 0;
-		for (int i = 0; i < 128; i++) {
-			if (keyPress < _keyPresses[i]) {
-				keyPress = _keyPresses[i];
-				previousNote = i;
-			}
-		}
+		// A note that doesn't take priority waits until those that do are released
+		if (_heldNotes.select(mNotePriority) != note)
+			return;
 
-		_keyPresses[note] = (++_keyPressCounter);
-		
 		VoiceBoard *voice = _voices[0];
+		voice->syncParameters(mPatch);
 		
 		voice->setVelocity(velocity);
 		voice->setFrequency(voice->getFrequency(), pitch, portamentoTime);
 		
 		if (_keyboardMode == KeyboardModeMono || previousNote == -1)
-			voice->triggerOn(!active[0]);
+			voice->triggerOn();
 		
-		active[0] = true;
+		if (!active[0])
+			activateVoice(0);
+		_voiceNote[0] = note;
 	}
 
 	mLastNoteFrequency = pitch;
@@ -201,49 +326,42 @@ VoiceAllocationUnit::HandleMidiNoteOff(int note, float /*velocity*/)
 	if (!tuningMap.inActiveRange(note))
 		return;
 
-	keyPressed[note] = false;
+	_pressedNotes.remove(note);
 
-	if (sustain)
+	if (sustain) {
+		if (!_sustained[note]) {
+			_sustained[note] = true;
+			_sustainedNotes[_sustainedCount++] = note;
+		}
 		return;
+	}
 
-	if (_keyboardMode == KeyboardModePoly) {
-		_voices[note]->triggerOff();
+	if (_keyboardMode == KeyboardModePoly && _noteVoice[note] >= 0) {
+		VoiceBoard *voice = _voices[_noteVoice[note]];
+		voice->syncParameters(mPatch);
+		voice->triggerOff();
+		_noteVoice[note] = -1;
 	}
 
+	const int currentNote = _heldNotes.select(mNotePriority);
+	_heldNotes.remove(note);
+
 	if (_keyboardMode == KeyboardModeMono || _keyboardMode == KeyboardModeLegato) {
-		int currentNote = -1;
-		unsigned keyPress = 0;
-		for (int i = 0; i < 128; i++) {
-			if (keyPress < _keyPresses[i]) {
-				keyPress = _keyPresses[i];
-				currentNote = i;
-			}
-		}
-		
-		_keyPresses[note] = 0;
-		
-		int nextNote = -1;
-		for (unsigned i = 0, tmp = 0; i < 128; i++) {
-			if (tmp < _keyPresses[i] && (keyPressed[i] || sustain)) {
-				tmp = _keyPresses[i];
-				nextNote = i;
-			}
-		}
-		
-		if (!keyPress) {
-			_keyPressCounter = 0;
-		}
-		
 		if (note != currentNote) {
 			return;
 		}
-		
+
+		// Notes still held only by the pedal have been released, so don't return to them
+		const int nextNote = _pressedNotes.select(mNotePriority);
+
 		VoiceBoard *voice = _voices[0];
+		voice->syncParameters(mPatch);
 		
 		if (0 <= nextNote) {
+			_voiceNote[0] = nextNote;
 			voice->setFrequency(voice->getFrequency(), (float) noteToPitch(nextNote), mPortamentoTime);
 			if (_keyboardMode == KeyboardModeMono)
-				voice->triggerOn(false);
+				voice->triggerOn();
 		} else {
 			voice->triggerOff();
 		}
@@ -281,9 +399,13 @@ VoiceAllocationUnit::HandleMidiSustainPedal(uchar value)
 	if ((sustain = (value > 0)))
 		return;
 
-	for (unsigned i = 0; i < _voices.size(); i++) {
-		if (!keyPressed[i] && _keyPresses[i] > 0) {
-			HandleMidiNoteOff(i, 0);
+	const unsigned count = _sustainedCount;
+	_sustainedCount = 0;
+	for (unsigned i = 0; i < count; i++) {
+		const int note = _sustainedNotes[i];
+		_sustained[note] = false;
+		if (!_pressedNotes.contains(note) && _heldNotes.contains(note)) {
+			HandleMidiNoteOff(note, 0);
 		}
 	}
 }
@@ -291,43 +413,205 @@ VoiceAllocationUnit::HandleMidiSustainPedal(uchar value)
 void
 VoiceAllocationUnit::resetAllVoices()
 {
-	for (unsigned i=0; i<_voices.size(); i++) {
+	for (int i = 0; i < 128; i++) {
+		_sustained[i] = false;
+		_noteVoice[i] = -1;
+	}
+	for (int i = 0; i < kMaxVoices; i++) {
 		active[i] = false;
-		keyPressed[i] = false;
-		_keyPresses[i] = 0;
+		_voiceNote[i] = -1;
+		_activeNext[i] = _activePrev[i] = -1;
+	}
+	// lowest numbered voices are allocated first
+	_freeCount = 0;
+	for (int i = (int) _voices.size() - 1; i >= 0; i--) {
 		_voices[i]->reset();
+		_freeVoices[_freeCount++] = i;
 	}
-	_keyPressCounter = 0;
+	_activeHead = _activeTail = -1;
+	_activeCount = 0;
+	_pressedNotes.clear();
+	_heldNotes.clear();
+	_sustainedCount = 0;
 	sustain = false;
 }
 
+void
+VoiceAllocationUnit::activateVoice(int voice)
+{
+	// The ramps only advance while voices play, so changes made since the
+	// last voice stopped (e.g. a new preset) would glide in on this one
+	if (_activeCount == 0)
+		mRamps->reset();
+
+	if (active[voice])
+		deactivateVoice(voice);
+
+	_activePrev[voice] = _activeTail;
+	_activeNext[voice] = -1;
+	if (_activeTail >= 0)
+		_activeNext[_activeTail] = voice;
+	else
+		_activeHead = voice;
+	_activeTail = voice;
+	active[voice] = true;
+	_activeCount++;
+}
+
+void
+VoiceAllocationUnit::deactivateVoice(int voice)
+{
+	if (!active[voice])
+		return;
+
+	const int prev = _activePrev[voice];
+	const int next = _activeNext[voice];
+	if (prev >= 0)
+		_activeNext[prev] = next;
+	else
+		_activeHead = next;
+	if (next >= 0)
+		_activePrev[next] = prev;
+	else
+		_activeTail = prev;
+	_activeNext[voice] = _activePrev[voice] = -1;
+	active[voice] = false;
+	_activeCount--;
+
+	const int note = _voiceNote[voice];
+	if (note >= 0 && _noteVoice[note] == voice)
+		_noteVoice[note] = -1;
+	_voiceNote[voice] = -1;
+
+	if (_keyboardMode == KeyboardModePoly)
+		_freeVoices[_freeCount++] = voice;
+}
+
+int
+VoiceAllocationUnit::allocateVoice()
+{
+	if (!_freeCount) {
+		// strategy 1) find the oldest voice in release phase
+		int idx = _activeHead;
+		while (idx >= 0 && _noteVoice[_voiceNote[idx]] == idx && _pressedNotes.contains(_voiceNote[idx]))
+			idx = _activeNext[idx];
+		if (idx < 0) {
+			// strategy 2) find the oldest voice
+			idx = _activeHead;
+		}
+		assert(0 <= idx && idx < (int) _voices.size());
+		deactivateVoice(idx);
+	}
+	assert(_freeCount > 0);
+	return _freeVoices[--_freeCount];
+}
+
+bool
+VoiceAllocationUnit::isNoteActive	(int note) const
+{
+	for (int i = _activeHead; i >= 0; i = _activeNext[i])
+		if (_voiceNote[i] == note)
+			return true;
+	return false;
+}
+
 void
 VoiceAllocationUnit::Process		(float *l, float *r, unsigned nframes, int stride)
 {
-	assert(nframes <= VoiceBoard::kMaxProcessBufferSize);
+	assert(nframes <= (unsigned) mBlockSize || IsIdle());
+
+	VoiceBoard *voices[kMaxVoices];
+	int count = 0;
 
-	memset(mBuffer, 0, nframes * sizeof (float));
+	for (int i = _activeHead, next; i >= 0; i = next) {
+		next = _activeNext[i];
+		if (_voices[i]->isSilent()) {
+			deactivateVoice(i);
+		} else {
+			_voices[i]->syncParameters(mPatch);
+			_voices[i]->SetPitchBend(mPitchBendValue);
+			voices[count++] = _voices[i];
+		}
+	}
 
-	for (unsigned i=0; i<_voices.size(); i++) {
-		if (active[i]) {
-			if (_voices[i]->isSilent()) {
-				active[i] = false;
-			} else {
-				_voices[i]->SetPitchBend(mPitchBendValue);
-				_voices[i]->ProcessSamplesMix (mBuffer, nframes, mMasterVol);
+	// Once the voices have stopped, each effect only runs until its tail
+	// has died away, and the output is silent after that
+	const bool drySilent = count == 0 && distortion->IsIdle();
+	const bool reverbSilent = drySilent && mReverbIdle;
+
+	mProcessedBlocks++;
+#ifdef AMSYNTH_COUNT_DENORMALS
+	DenormalGuard::clearUnderflow();
+#endif
+
+	if (count > 0) {
+		memset(mBuffer, 0, nframes * sizeof (float));
+		mRamps->process (nframes);
+		if (mRenderPool) {
+			mRenderPool->process (voices, count, mBuffer, nframes, *mRamps);
+		} else {
+			for (int i = 0; i < count; i += VoiceBoard::kMaxBankSize) {
+				int bankSize = std::min(count - i, VoiceBoard::kMaxBankSize);
+				if (bankSize == 1) {
+					voices[i]->ProcessSamplesMix (mBuffer, nframes, *mRamps, *mWorkspace);
+				} else {
+					VoiceBoard::ProcessSamplesMix (voices + i, bankSize, mBuffer, nframes, *mRamps, *mWorkspace);
+				}
 			}
 		}
+		COUNT_DENORMALS(kDenormalStageVoices, mRenderPool && mRenderPool->takeUnderflow());
+		distortion->Process (mBuffer, nframes);
+		COUNT_DENORMALS(kDenormalStageDistortion, false);
+	} else if (!drySilent) {
+		memset(mBuffer, 0, nframes * sizeof (float));
+		distortion->ProcessSilence (mBuffer, nframes);
+		COUNT_DENORMALS(kDenormalStageDistortion, false);
 	}
 
-	distortion->Process (mBuffer, nframes);
+	if (drySilent) {
+		for (unsigned i=0; i<nframes; i++) {
+			l[i * stride] = 0.f;
+			r[i * stride] = 0.f;
+		}
+	} else {
+		for (unsigned i=0; i<nframes; i++) {
+			l[i * stride] = mBuffer[i] * mPanGainLeft;
+			r[i * stride] = mBuffer[i] * mPanGainRight;
+		}
+		mReverbIdle = false;
+	}
 
-	for (unsigned i=0; i<nframes; i++) {
-		l[i * stride] = mBuffer[i] * mPanGainLeft;
-		r[i * stride] = mBuffer[i] * mPanGainRight;
+	if (!reverbSilent) {
+		reverb->processmix (l, r, l, r, nframes, stride);
+		// The tail has died away once the output has stayed below the
+		// threshold for long enough to have drained the delay lines
+		float peak = 0.f;
+		if (drySilent) {
+			for (unsigned i=0; i<nframes; i++)
+				peak = std::max(peak, std::max(fabsf(l[i * stride]), fabsf(r[i * stride])));
+		}
+		mReverbQuietFrames = (drySilent && peak < kSilenceThreshold) ? mReverbQuietFrames + nframes : 0;
+		if (mReverbQuietFrames >= reverb->getdelaylength()) {
+			// Discard what's left, rather than have it sound again when
+			// the reverb is next fed
+			reverb->mute();
+			mReverbIdle = true;
+		}
+		COUNT_DENORMALS(kDenormalStageReverb, false);
 	}
 
-	reverb->processmix (l, r, l, r, nframes, stride);
-	limiter->Process (l,r, nframes, stride);
+	if (reverbSilent) {
+		limiter->ProcessSilence (l, r, nframes, stride);
+	} else {
+		limiter->Process (l, r, nframes, stride);
+	}
+	COUNT_DENORMALS(kDenormalStageLimiter, false);
+}
+
+bool
+VoiceAllocationUnit::IsIdle		() const
+{
+	return _activeHead < 0 && distortion->IsIdle() && mReverbIdle && limiter->IsIdle();
 }
 
 void
@@ -339,11 +623,20 @@ VoiceAllocationUnit::setKeyboardMode(KeyboardMode keyboardMode)
 	}
 }
 
+void
+VoiceAllocationUnit::SetNotePriority(NotePriority priority)
+{
+	if (mNotePriority != priority) {
+		mNotePriority = priority;
+		if (_keyboardMode != KeyboardModePoly)
+			resetAllVoices();
+	}
+}
+
 void
 VoiceAllocationUnit::UpdateParameter	(Param param, float value)
 {
 	switch (param) {
-	case kAmsynthParameter_MasterVolume:		mMasterVol = value;		break;
 	case kAmsynthParameter_ReverbRoomsize:	reverb->setroomsize (value);	break;
 	case kAmsynthParameter_ReverbDamp:		reverb->setdamp (value);	break;
 	case kAmsynthParameter_ReverbWet:		reverb->setwet (value); reverb->setdry(1.0f-value); break;
@@ -367,14 +660,9 @@ VoiceAllocationUnit::UpdateParameter	(Param param, float value)
 	case kAmsynthParameter_FilterCutoff:
 	case kAmsynthParameter_Oscillator2Detune:
 	case kAmsynthParameter_Oscillator2Waveform:
-	case kAmsynthParameter_LFOFreq:
-	case kAmsynthParameter_LFOWaveform:
 	case kAmsynthParameter_Oscillator2Octave:
-	case kAmsynthParameter_OscillatorMix:
 	case kAmsynthParameter_LFOToOscillators:
 	case kAmsynthParameter_LFOToFilterCutoff:
-	case kAmsynthParameter_LFOToAmp:
-	case kAmsynthParameter_OscillatorMixRingMod:
 	case kAmsynthParameter_Oscillator1Pulsewidth:
 	case kAmsynthParameter_Oscillator2Pulsewidth:
 	case kAmsynthParameter_Oscillator2Sync:
@@ -384,10 +672,25 @@ VoiceAllocationUnit::UpdateParameter	(Param param, float value)
 	case kAmsynthParameter_LFOOscillatorSelect:
 	case kAmsynthParameter_FilterKeyTrackAmount:
 	case kAmsynthParameter_FilterKeyVelocityAmount:
+		// voices pick up the change in syncParameters()
+		mPatch.set (param, value);
+		break;
+
+	case kAmsynthParameter_LFOFreq:
+	case kAmsynthParameter_LFOWaveform:
+		// for the voices' own LFOs and the global one
+		mPatch.set (param, value);
+		mRamps->UpdateParameter (param, value);
+		break;
+
+	case kAmsynthParameter_MasterVolume:
+	case kAmsynthParameter_OscillatorMix:
+	case kAmsynthParameter_OscillatorMixRingMod:
+	case kAmsynthParameter_LFOToAmp:
 	case kAmsynthParameter_AmpVelocityAmount:
-		for (unsigned i=0; i<_voices.size(); i++) {
-			_voices[i]->UpdateParameter (param, value);
-		}
+	case kAmsynthParameter_LFOMode:
+		// smoothed, or in the LFO's case run, once per block for all voices
+		mRamps->UpdateParameter (param, value);
 		break;
 
 	case kAmsynthParameterCount:
@@ -24,18 +24,34 @@
 
 #include "UpdateListener.h"
 #include "MidiController.h"
+#include "NoteStack.h"
 #include "TuningMap.h"
+#include "VoiceBoard/VoiceBoard.h"
 
 #include <stdint.h>
 #include <vector>
 
 
-class VoiceBoard;
+class VoiceRenderPool;
 class SoftLimiter;
 class revmodel;
 class Distortion;
 
 
+/**
+ * Voices built by VoiceAllocationUnit::CreateVoicePool, so that a change of
+ * polyphony can be allocated away from the audio thread and swapped in.
+ */
+struct VoicePool
+{
+	~VoicePool() { for (VoiceBoard *voice : voices) delete voice; }
+
+	int		maxVoices;
+	std::vector<VoiceBoard*>	voices;
+	VoicePool	*next = nullptr; // for Synthesizer's list of pools to delete
+};
+
+
 class VoiceAllocationUnit : public UpdateListener, public MidiEventHandler
 {
 public:
@@ -55,14 +71,102 @@ public:
 	void	HandleMidiSustainPedal(uchar value) override;
 	void	HandleMidiPan(float left, float right) override { mPanGainLeft = left; mPanGainRight = right; }
 
-	void	SetMaxVoices	(int voices) { mMaxVoices = voices; }
+	static constexpr int kMaxVoices = 128;
+
+	/**
+	 * Sets the polyphony, 0 meaning unlimited (kMaxVoices). Voices are
+	 * allocated to match, so this silences all voices and must not be called
+	 * concurrently with Process(); see CreateVoicePool for the alternative.
+	 */
+	void	SetMaxVoices	(int voices);
 	int		GetMaxVoices	() { return mMaxVoices; }
 
+	/**
+	 * Allocates voices for the polyphony, set up like the current ones.
+	 * The voices in use are untouched, so this may run on another thread
+	 * while Process() does, as long as the voice settings don't change.
+	 */
+	VoicePool *	CreateVoicePool	(int voices) const;
+
+	/**
+	 * Puts a pool from CreateVoicePool in use, silencing all voices, without
+	 * allocating. Must not be called concurrently with Process().
+	 * @return the previous voices, to be deleted away from the audio thread
+	 */
+	VoicePool *	SwapVoicePool	(VoicePool *);
+
+	bool	isNoteActive	(int note) const;
+
+	/**
+	 * The number of frames rendered per call to Process, up to
+	 * VoiceBoard::kMaxProcessBufferSize. Modulation (e.g. the filter cutoff)
+	 * is updated once per block, so smaller blocks track it more closely
+	 * while larger blocks spread the per-block overhead over more frames.
+	 */
+	static constexpr int kDefaultBlockSize = 64;
+	void	SetBlockSize	(int frames);
+	int		GetBlockSize	() const { return mBlockSize; }
+
+	/**
+	 * Sets the number of threads used to render voices, including the audio
+	 * thread. 1 (the default) renders everything on the audio thread. Must
+	 * not be called concurrently with Process().
+	 */
+	void	SetRenderThreads	(int threads);
+	int		GetRenderThreads	() const;
+
+	/**
+	 * Switches every voice's audio oscillators to band-limited wavetables
+	 * (see Oscillator::setBandLimited).
+	 */
+	void	SetBandLimitedOscillators	(bool enabled);
+	bool	GetBandLimitedOscillators	() const { return mBandLimitedOscillators; }
+
+	/**
+	 * Switches every voice's filter to per-sample cutoff modulation
+	 * (see VoiceBoard::setSVFFilter).
+	 */
+	void	SetSVFFilter	(bool enabled);
+	bool	GetSVFFilter	() const { return mSVFFilter; }
+
+	/**
+	 * Sets how often, in samples, every voice updates its LFO and filter
+	 * envelope (see VoiceBoard::setControlPeriod).
+	 */
+	void	SetControlPeriod	(int samples);
+	int		GetControlPeriod	() const { return mControlPeriod; }
+
+	/**
+	 * Reseeds the noise generators of every voice, each with a different
+	 * seed derived from this one. Two engines with the same seed render the
+	 * same noise given the same input.
+	 */
+	void	SetRandomSeed	(uint32_t seed);
+	uint32_t	GetRandomSeed	() const { return mRandomSeed; }
+
+	/** 1, 2 or 4; see Distortion::SetOversampling */
+	void	SetDistortionOversampling	(int factor);
+	int		GetDistortionOversampling	() const;
+
+	/** See SoftLimiter::SetLookahead */
+	void	SetLimiterLookahead	(float seconds);
+
 	void	setPitchBendRangeSemitones(float range) { mPitchBendRangeSemitones = range; }
 	void	setKeyboardMode(KeyboardMode);
 
+	/** Which held note the voice plays in mono and legato modes */
+	void	SetNotePriority	(NotePriority);
+	NotePriority	GetNotePriority	() const { return mNotePriority; }
+
 	void	Process			(float *l, float *r, unsigned nframes, int stride=1);
 
+	/**
+	 * True when no voice is active and the effects' tails have died away, so
+	 * that Process() has nothing to do but output silence. An idle unit
+	 * accepts any number of frames at a time.
+	 */
+	bool	IsIdle			() const;
+
 	double	noteToPitch		(int note) const;
 	int		loadScale		(const std::string & sclFileName);
 	int		loadKeyMap		(const std::string & kbmFileName);
@@ -71,32 +175,93 @@ public:
 
 	void	resetAllVoices();
 
+	void	activateVoice	(int voice);
+	void	deactivateVoice	(int voice);
+
+	int		allocateVoice	();
+
 	int		mMaxVoices;
+	int		mBlockSize;
+	int		mSampleRate;
+	bool	mBandLimitedOscillators;
+	bool	mSVFFilter;
+	int		mControlPeriod;
+	uint32_t	mRandomSeed;
 
 	float	mPortamentoTime;
 	int		mPortamentoMode;
-	bool	keyPressed[128], sustain;
-	bool	active[128];
+	bool	sustain;
+	NotePriority	mNotePriority;
+
+	// Notes whose keys are down, and those plus the notes still held by the
+	// sustain pedal
+	NoteStack	_pressedNotes;
+	NoteStack	_heldNotes;
+
+	// Voices are not tied to notes; each voice records the note it is
+	// playing, and each note the voice it is holding (if any). Older voices
+	// for the same note are left to ring out in their release phase.
+	bool	active[kMaxVoices];
+	int		_voiceNote[kMaxVoices];
+	int		_noteVoice[128];
+
+	// Voices that are not active, in poly mode
+	int		_freeVoices[kMaxVoices];
+	unsigned	_freeCount;
+
+	// Active voices form an intrusive doubly-linked list, ordered from the
+	// least to the most recently triggered, so that per-block and voice
+	// stealing work is proportional to the number of active voices.
+	int		_activeHead;
+	int		_activeTail;
+	int		_activeNext[kMaxVoices];
+	int		_activePrev[kMaxVoices];
+	unsigned	_activeCount;
+
+	// Notes released while the sustain pedal was held
+	bool	_sustained[128];
+	int		_sustainedNotes[128];
+	unsigned	_sustainedCount;
 	
 	unsigned	_keyboardMode;
-	unsigned	_keyPresses[128];
-	unsigned	_keyPressCounter;
 	
 	std::vector<VoiceBoard*>	_voices;
+	PatchParameters	mPatch;
+	VoiceRenderPool	*mRenderPool;
 	
 	SoftLimiter	*limiter;
 	revmodel	*reverb;
 	Distortion	*distortion;
 	
 	float	*mBuffer;
+	VoiceBoard::Workspace	*mWorkspace;
+	VoiceBoard::SharedRamps	*mRamps;
 
-	float	mMasterVol;
 	float	mPanGainLeft;
 	float	mPanGainRight;
 	float	mPitchBendRangeSemitones;
 	float	mPitchBendValue;
 	float	mLastNoteFrequency;
 
+	// The reverb stops being processed once its input is silent and its
+	// output has been below kSilenceThreshold for mReverbQuietFrames
+	static constexpr float kSilenceThreshold = 1e-5f; // -100 dBFS
+	bool	mReverbIdle;
+	int		mReverbQuietFrames;
+
+	// The number of blocks in which each stage flushed denormals to zero,
+	// which is only counted in builds configured with AMSYNTH_COUNT_DENORMALS
+	// (and reported on destruction)
+	enum DenormalStage {
+		kDenormalStageVoices,
+		kDenormalStageDistortion,
+		kDenormalStageReverb,
+		kDenormalStageLimiter,
+		kDenormalStageCount
+	};
+	unsigned long	mDenormalBlocks[kDenormalStageCount];
+	unsigned long	mProcessedBlocks;
+
 	TuningMap	tuningMap;
 };
 
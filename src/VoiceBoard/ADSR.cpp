@@ -20,27 +20,90 @@
  */
 
 #include "ADSR.h"
+#include "SIMD.h"
 
 #include <algorithm>
 #include <cassert>
+#include <cmath>
 
 static const float kMinimumTime = 0.0005f;
 
+// How far past its target a curve is aimed, as a fraction of its height.
+// The smaller this is, the more the curve bends; at 0.01 the distance to the
+// asymptote shrinks by 40 dB over the segment, for an analog-like RC shape.
+static const float kCurveOvershoot = 0.01f;
+
+// The per-frame coefficient by which the sustain level glides to a new
+// setting, as ParamSmoother, and how close it must get to be snapped there.
+static const float kSustainCoef = 0.995f;
+static const float kSustainTolerance = 1e-6f;
+
+// buffer[i] = value + inc * i
+static void linearRamp(float *buffer, unsigned count, float value, float inc)
+{
+	unsigned i = 0;
+	if (count >= 4) {
+		// counting exactly in float, so that long ramps don't drift
+		const float indices[4] = { 0.f, 1.f, 2.f, 3.f };
+		simd::float4 index = simd::load(indices);
+		for (; i + 4 <= count; i += 4) {
+			simd::store(buffer + i, value + index * inc);
+			index = index + 4.f;
+		}
+	}
+	for (; i < count; i++) {
+		buffer[i] = value + inc * i;
+	}
+}
+
+// buffer[i] = asymptote + (value - asymptote) * coef^i, with the powers of coef
+// stepped four at a time; returns the value for frame count
+static float exponentialRamp(float *buffer, unsigned count, float value, float asymptote, float coef)
+{
+	float d = value - asymptote;
+	unsigned i = 0;
+	if (count >= 4) {
+		const float powers[4] = { d, d * coef, d * coef * coef, d * coef * coef * coef };
+		const float coef2 = coef * coef;
+		const simd::float4 coef4 = coef2 * coef2;
+		simd::float4 y = simd::load(powers);
+		for (; i + 4 <= count; i += 4) {
+			simd::store(buffer + i, asymptote + y);
+			y = y * coef4;
+		}
+		float next[4];
+		simd::store(next, y);
+		d = next[0];
+	}
+	for (; i < count; i++) {
+		buffer[i] = asymptote + d;
+		d *= coef;
+	}
+	return asymptote + d;
+}
+
+void
+ADSR::beginCurve(float target, unsigned frames)
+{
+	m_asymptote = target + (target - m_value) * kCurveOvershoot;
+	m_coef = frames ? powf(kCurveOvershoot / (1.f + kCurveOvershoot), 1.f / frames) : 0.f;
+	m_frames_left_in_state = frames;
+}
+
 void
 ADSR::triggerOn()
 {
 	m_state = State::kAttack;
 	m_frames_left_in_state = (int) (m_attack * m_sample_rate);
 	const float target = m_decay <= kMinimumTime ? m_sustain : 1.0;
-	m_inc = (target - m_value) / (float) m_frames_left_in_state;
+	m_inc = m_frames_left_in_state ? (target - m_value) / (float) m_frames_left_in_state : 0.f;
 }
 
 void 
 ADSR::triggerOff()
 {
 	m_state = State::kRelease;
-	m_frames_left_in_state = (int) (m_release * m_sample_rate);
-	m_inc = (0.f - m_value) / (float) m_frames_left_in_state;
+	beginCurve(0.f, (int) (m_release * m_sample_rate));
 }
 
 void
@@ -59,34 +122,42 @@ ADSR::process(float *buffer, unsigned frames)
 
 		const unsigned int count = std::min(frames, m_frames_left_in_state);
 
-		if (m_state == State::kSustain) {
-			for (unsigned i = 0; i < count; i++) {
-				*buffer = m_value;
-				m_value = m_sustain_smoother.processSample(m_sustain);
-				buffer++;
-			}
-		} else {
-			for (unsigned i = 0; i < count; i++) {
-				*buffer = m_value;
-				m_value += m_inc;
-				buffer++;
-			}
+		switch (m_state) {
+			case State::kAttack:
+				linearRamp(buffer, count, m_value, m_inc);
+				m_value += m_inc * count;
+				break;
+			case State::kSustain:
+				if (m_value == m_asymptote) {
+					std::fill(buffer, buffer + count, m_value);
+					break;
+				}
+				m_value = exponentialRamp(buffer, count, m_value, m_asymptote, kSustainCoef);
+				if (fabsf(m_value - m_asymptote) < kSustainTolerance)
+					m_value = m_asymptote;
+				break;
+			case State::kDecay:
+			case State::kRelease:
+				m_value = exponentialRamp(buffer, count, m_value, m_asymptote, m_coef);
+				break;
+			case State::kOff:
+				std::fill(buffer, buffer + count, 0.f);
+				break;
 		}
 
+		buffer += count;
 		m_frames_left_in_state -= count;
 
 		if (m_frames_left_in_state == 0) {
 			switch (m_state) {
 				case State::kAttack:
 					m_state = State::kDecay;
-					m_frames_left_in_state = (int) (m_decay * m_sample_rate);
-					m_inc = (m_sustain - m_value) / (float) m_frames_left_in_state;
+					beginCurve(m_sustain, (int) (m_decay * m_sample_rate));
 					break;
 				case State::kDecay:
-					m_sustain_smoother.set(m_value);
 					m_state = State::kSustain;
 					m_frames_left_in_state = UINT_MAX;
-					m_inc = 0;
+					m_asymptote = m_sustain;
 					break;
 				case State::kSustain:
 					m_frames_left_in_state = UINT_MAX;
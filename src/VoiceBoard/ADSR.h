@@ -22,10 +22,17 @@
 #ifndef _ADSR_H
 #define _ADSR_H
 
-#include "Synth--.h"
-
 #include <climits>
 
+/**
+ * The attack is a linear ramp; the decay and release are exponential, like
+ * the discharge of a capacitor, but aimed a little past their targets so
+ * that they get there in the time set. A change to the sustain level glides
+ * there exponentially too.
+ *
+ * Each segment is written out a block at a time, in closed form, so that
+ * none of them is a serial chain of one sample per step.
+ */
 class ADSR
 {
 public:
@@ -37,11 +44,11 @@ public:
 		kOff
 	};
 
-	void	SetSampleRate	(int value) { m_sample_rate = value; }
+	void	SetSampleRate	(float value) { m_sample_rate = value; }
 
 	void	SetAttack	(float value) { m_attack = value; }
 	void	SetDecay	(float value) { m_decay = value; }
-	void	SetSustain	(float value) { m_sustain = value; if (m_state == State::kSustain) m_value = value; }
+	void	SetSustain	(float value) { m_sustain = value; if (m_state == State::kSustain) m_asymptote = value; }
 	void	SetRelease	(float value) { m_release = value; }
 	
 	void	process		(float *buffer, unsigned frames);
@@ -58,17 +65,20 @@ public:
 	void reset();
 
 private:
+	void	beginCurve	(float target, unsigned frames);
+
 	float			m_attack = 0;
 	float			m_decay = 0;
 	float			m_sustain = 1;
-	ParamSmoother	m_sustain_smoother{1.f};
 	float			m_release = 0;
 
 	float			m_sample_rate = 44100;
 	State			m_state = State::kOff;
 
 	float			m_value = 0.0F;
-	float			m_inc = 0.0F;
+	float			m_inc = 0.0F;		// per frame, in the attack
+	float			m_asymptote = 0.0F;	// approached by m_value in the decay, sustain and release
+	float			m_coef = 0.0F;		// by which m_value - m_asymptote shrinks every frame
 	unsigned		m_frames_left_in_state = UINT_MAX;
 };
 
@@ -0,0 +1,74 @@
+/*
+ *  CPUFeatures.cpp
+ *
+ *  Copyright (c) 2022 Nick Dowell
+ *
+ *  This file is part of amsynth.
+ *
+ *  amsynth is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  amsynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with amsynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "CPUFeatures.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+namespace cpu {
+
+static Level detect()
+{
+#if defined(AMSYNTH_CPU_DISPATCH)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+		return Level::kAVX2;
+#endif
+	return Level::kBaseline;
+}
+
+static Level fromEnvironment()
+{
+	const char *name = getenv("AMSYNTH_CPU_LEVEL");
+	if (name && strcmp(name, "baseline") == 0)
+		return Level::kBaseline;
+	return supported();
+}
+
+// -1 until the level has been chosen, so that the environment is only read
+// once, and read at all only if force() isn't called first
+static std::atomic<int> sActive{-1};
+
+Level supported()
+{
+	static const Level level = detect();
+	return level;
+}
+
+Level active()
+{
+	int level = sActive.load(std::memory_order_relaxed);
+	if (level < 0) {
+		level = (int) fromEnvironment();
+		sActive.store(level, std::memory_order_relaxed);
+	}
+	return (Level) level;
+}
+
+void force(Level level)
+{
+	sActive.store(std::min((int) level, (int) supported()), std::memory_order_relaxed);
+}
+
+} // namespace cpu
@@ -0,0 +1,80 @@
+/*
+ *  CPUFeatures.h
+ *
+ *  Copyright (c) 2022 Nick Dowell
+ *
+ *  This file is part of amsynth.
+ *
+ *  amsynth is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  amsynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with amsynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _CPUFEATURES_H
+#define _CPUFEATURES_H
+
+//
+// Runtime selection of the instruction set for the hot DSP kernels.
+//
+// The engine is built for the baseline instruction set of the target, so
+// that one binary runs everywhere. Where the compiler can target a single
+// function at a later instruction set, a kernel is compiled a second time
+// for AVX2 + FMA by a wrapper marked AMSYNTH_TARGET_AVX2 around the same
+// AMSYNTH_ALWAYS_INLINE implementation, and the caller picks one of the two
+// with AMSYNTH_CPU_SELECT.
+//
+// Only the wrapper and what is inlined into it use the later instructions.
+// Anything the kernel calls out of line stays baseline code, so nothing
+// shared between the variants can end up being compiled for AVX2.
+//
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define AMSYNTH_CPU_DISPATCH 1
+#define AMSYNTH_TARGET_AVX2 __attribute__((target("avx2,fma")))
+#define AMSYNTH_ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define AMSYNTH_ALWAYS_INLINE inline
+#endif
+
+namespace cpu {
+
+enum class Level {
+	kBaseline,
+	kAVX2, // AVX2 and FMA
+};
+
+/** The best level this CPU supports, detected on first use */
+Level supported();
+
+/**
+ * The level the kernels run at: supported(), unless lowered by force() or
+ * by the AMSYNTH_CPU_LEVEL environment variable ("baseline" or "avx2").
+ * Always kBaseline in builds without AMSYNTH_CPU_DISPATCH.
+ */
+Level active();
+
+/**
+ * Overrides the level for testing and benchmarking; levels the CPU (or the
+ * build) doesn't support fall back to the best one it does.
+ */
+void force(Level);
+
+} // namespace cpu
+
+/** Picks the variant of a kernel to run, by cpu::active() where there is a choice */
+#if defined(AMSYNTH_CPU_DISPATCH)
+#define AMSYNTH_CPU_SELECT(baseline, avx2) (cpu::active() == cpu::Level::kAVX2 ? (avx2) : (baseline))
+#else
+#define AMSYNTH_CPU_SELECT(baseline, avx2) (baseline)
+#endif
+
+#endif
@@ -0,0 +1,199 @@
+/*
+ *  FastMath.h
+ *
+ *  Copyright (c) 2022 Nick Dowell
+ *
+ *  This file is part of amsynth.
+ *
+ *  amsynth is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  amsynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with amsynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FASTMATH_H
+#define _FASTMATH_H
+
+#include "SIMD.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+//
+// Polynomial approximations of the libm functions used on the audio thread.
+//
+// They are single precision, inline and free of branches and table lookups.
+// Each is available for float and for simd::float4, computing exactly the
+// same result either way, and transform() applies one to a whole buffer
+// four values at a time.
+//
+// Inputs outside the documented domains give unspecified results. The error
+// bounds are checked against libm by testFastMath in tests.cpp.
+//
+
+namespace fastmath {
+
+namespace detail {
+
+// Scalar counterparts of the simd::float4 operations, so that each function
+// is written once for both types
+inline float abs(float x) { return std::fabs(x); }
+inline float copysign(float a, float b) { return std::copysign(a, b); }
+inline int32_t truncate(float x) { return (int32_t)x; }
+inline float toFloat(int32_t i) { return (float)i; }
+inline int32_t bitsOf(float x) { int32_t i; memcpy(&i, &x, sizeof i); return i; }
+inline float fromBits(int32_t i) { float x; memcpy(&x, &i, sizeof x); return x; }
+// a conditional move rather than a branch, which would be unpredictable
+inline float select(bool m, float a, float b) { const int32_t mask = -(int32_t)m; return fromBits((bitsOf(a) & mask) | (bitsOf(b) & ~mask)); }
+inline float min(float a, float b) { return select(a < b, a, b); }
+inline float max(float a, float b) { return select(a > b, a, b); }
+inline int32_t shiftLeft(int32_t i, int n) { return (int32_t)((uint32_t)i << n); }
+inline simd::int4 shiftLeft(simd::int4 i, int n) { return i << n; }
+
+template <typename T>
+inline T floor(T x)
+{
+	const T i = toFloat(truncate(x));
+	return i - select(i > x, T(1.f), T(0.f));
+}
+
+// sin(2 pi t) for t in [-0.75, 0.75]
+template <typename T>
+inline T sin2pi(T t)
+{
+	// sin(pi - x) = sin(x) folds t into [-0.25, 0.25]
+	const T folded = select(abs(t) < T(0.25f), t, copysign(T(0.5f), t) - t);
+	const T x = folded * 6.28318530717958647692f;
+	const T x2 = x * x;
+	// Taylor series to x^11, truncation error < 6e-8 on [-pi/2, pi/2]
+	return x * (1.f + x2 * (-1.f / 6 + x2 * (1.f / 120 + x2 * (-1.f / 5040 + x2 * (1.f / 362880 + x2 * (-1.f / 39916800))))));
+}
+
+// x - 2 pi n, in cycles, for the integer n that leaves the result close to
+// [-0.5, 0.5]. 2 pi is split into a part with a short mantissa (exact in the
+// product with n) and a small correction, which keeps the error of the
+// reduction well below that of the polynomial for |x| < 2^16.
+template <typename T>
+inline T reduce(T x)
+{
+	const T n = floor(x * 0.159154943091895335769f + 0.5f);
+	const T r = (x - n * 6.28125f) - n * 1.93530717958647692e-3f;
+	return r * 0.159154943091895335769f;
+}
+
+template <typename T>
+inline T sin(T x)
+{
+	return sin2pi(reduce(x));
+}
+
+template <typename T>
+inline T cos(T x)
+{
+	const T t = reduce(x) + 0.25f;
+	return sin2pi(t - select(t > T(0.5f), T(1.f), T(0.f)));
+}
+
+template <typename T>
+inline T exp2(T x)
+{
+	x = min(max(x, T(-126.f)), T(127.f));
+	const T n = floor(x + 0.5f);
+	const T f = (x - n) * 0.693147180559945309417f; // |f| <= ln(2) / 2
+	// Taylor series of e^f to f^6, truncation error < 1.3e-7
+	const T p = 1.f + f * (1.f + f * (1.f / 2 + f * (1.f / 6 + f * (1.f / 24 + f * (1.f / 120 + f * (1.f / 720))))));
+	return p * fromBits(shiftLeft(truncate(n) + 127, 23));
+}
+
+template <typename T>
+inline T log2(T x)
+{
+	// x = m * 2^e with m in [sqrt(1/2), sqrt(2))
+	const auto bits = bitsOf(x);
+	const auto e = (bits - 0x3f3504f3) >> 23; // 0x3f3504f3 is sqrt(1/2)
+	const T m = fromBits(bits - shiftLeft(e, 23));
+	// log(m) = 2 atanh(s), with |s| <= 0.172
+	const T s = (m - 1.f) / (m + 1.f);
+	const T s2 = s * s;
+	const T logm = 2.f * s * (1.f + s2 * (1.f / 3 + s2 * (1.f / 5 + s2 * (1.f / 7 + s2 * (1.f / 9)))));
+	return toFloat(e) + logm * 1.44269504088896340736f;
+}
+
+} // namespace detail
+
+/** sin(x), with absolute error < 5e-7 for |x| < 256 and < 2e-6 for |x| < 2^16 */
+inline float sin(float x) { return detail::sin(x); }
+inline simd::float4 sin(simd::float4 x) { return detail::sin(x); }
+
+/** cos(x), error as for sin() */
+inline float cos(float x) { return detail::cos(x); }
+inline simd::float4 cos(simd::float4 x) { return detail::cos(x); }
+
+/**
+ * tan(x) for x in [0, pi/2), with relative error < 3e-6 up to x = 1.5
+ * (e.g. a filter cutoff of 0.48 * the sample rate).
+ */
+inline float tan(float x) { return detail::sin(x) / detail::cos(x); }
+inline simd::float4 tan(simd::float4 x) { return detail::sin(x) / detail::cos(x); }
+
+/**
+ * 2^x, with relative error < 3e-7 for x in [-126, 127]. Results that would
+ * underflow or overflow are clamped to 2^-126 and 2^127 respectively.
+ */
+inline float exp2(float x) { return detail::exp2(x); }
+inline simd::float4 exp2(simd::float4 x) { return detail::exp2(x); }
+
+/**
+ * log2(x) for normal x > 0, with error < 1e-7 (absolute where |log2(x)| < 1,
+ * relative elsewhere).
+ */
+inline float log2(float x) { return detail::log2(x); }
+inline simd::float4 log2(simd::float4 x) { return detail::log2(x); }
+
+/** e^x, with relative error < 1e-6 for |x| < 10 and < 5e-6 for x in [-87, 88] */
+inline float exp(float x) { return detail::exp2(x * 1.44269504088896340736f); }
+inline simd::float4 exp(simd::float4 x) { return detail::exp2(x * 1.44269504088896340736f); }
+
+/** The natural logarithm of normal x > 0, with error < 2e-7 as for log2() */
+inline float log(float x) { return detail::log2(x) * 0.693147180559945309417f; }
+inline simd::float4 log(simd::float4 x) { return detail::log2(x) * 0.693147180559945309417f; }
+
+/**
+ * x^y for x >= 0, with relative error < 2e-6 where |y log2(x)| < 20.
+ * Returns 0 for x = 0 (the limit for y > 0).
+ */
+inline float pow(float x, float y) { return detail::select(x > 0.f, detail::exp2(y * detail::log2(x)), 0.f); }
+inline simd::float4 pow(simd::float4 x, simd::float4 y) { return select(x > 0.f, detail::exp2(y * detail::log2(x)), 0.f); }
+
+/**
+ * Replaces each of the n values in buffer with f(value). f is called with
+ * simd::float4 for all but the last (n % 4) values, so it must accept both
+ * types, e.g.
+ *
+ *   struct Sine {
+ *       float operator()(float x) const { return fastmath::sin(x); }
+ *       simd::float4 operator()(simd::float4 x) const { return fastmath::sin(x); }
+ *   };
+ */
+template <typename Function>
+inline void transform(float *buffer, int n, Function f)
+{
+	int i = 0;
+	for (; i + 4 <= n; i += 4)
+		simd::store(buffer + i, f(simd::load(buffer + i)));
+	for (; i < n; i++)
+		buffer[i] = f(buffer[i]);
+}
+
+} // namespace fastmath
+
+#endif
@@ -39,20 +39,70 @@ public:
 		k24,
 	};
 
-	void SetSampleRate(int rateIn) { rate = (float)rateIn; nyquist = rate / 2.0f; }
+	/**
+	 * The coefficients of one state-variable filter section, see
+	 * LowPassFilter.cpp. p1..p3 set the cutoff and resonance, and m0..m2
+	 * mix the response of the filter type from the section's outputs.
+	 */
+	struct Coefficients {
+		float p1, p2, p3, m0, m1, m2;
+	};
+
+	/**
+	 * The number of filters processed together by the multi-voice
+	 * ProcessSamples(). Their states are held in structure-of-arrays form
+	 * so that each sample is computed for all lanes at once.
+	 */
+#if defined(__AVX__)
+	static constexpr int kMaxLanes = 8;
+#else
+	static constexpr int kMaxLanes = 4;
+#endif
+
+	void SetSampleRate(int rateIn) { rate = (float)rateIn; nyquist = rate / 2.0f; cachedType = Type::kBypass; }
 
 	void reset();
 
+	/**
+	 * The result is cached, so calling this again with the same arguments
+	 * (e.g. for a held note with no modulation) costs only the comparison.
+	 *
+	 * @return false if the filter is bypassed and no processing is required.
+	 */
+	bool calculateCoefficients(float cutoff, float res, Type type, Coefficients &coefficients);
+
 	void ProcessSamples(float *, int, float cutoff, float res, Type type, Slope slope);
+	void ProcessSamples(float *, int, const Coefficients &coefficients, Slope slope);
+
+	/**
+	 * Processes up to kMaxLanes filters, each with its own buffer and
+	 * coefficients but all sharing the same slope.
+	 */
+	static void ProcessSamples(SynthFilter *filters[], float *buffers[], const Coefficients coefficients[],
+							   int count, int numSamples, Slope slope);
+
+	/**
+	 * As above, but with the cutoff changing every sample. Each filter takes
+	 * its cutoff in Hz per sample from cutoffs, and its own resonance; the
+	 * type and slope are shared.
+	 */
+	static void ProcessSamples(SynthFilter *filters[], float *buffers[], const float *cutoffs[], const float res[],
+							   int count, int numSamples, Type type, Slope slope);
 
 private:
 
 	float rate = 44100;
 	float nyquist = 22050.0;
-	double d1 = 0;
-	double d2 = 0;
-	double d3 = 0;
-	double d4 = 0;
+	float d1 = 0;
+	float d2 = 0;
+	float d3 = 0;
+	float d4 = 0;
+
+	// the arguments and result of the last calculateCoefficients() call
+	Type cachedType = Type::kBypass;
+	float cachedCutoff = 0;
+	float cachedRes = 0;
+	Coefficients cached;
 };
 
 #endif
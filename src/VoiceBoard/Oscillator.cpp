@@ -21,10 +21,14 @@
 
 #include "Oscillator.h"
 
+#include "FastMath.h"
+#include "SIMD.h"
+#include "Wavetable.h"
+
 #include <algorithm>
 #include <cassert>
-#include <climits>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
 
 #define ALIAS_REDUCTION
@@ -33,8 +37,13 @@ static inline float ffmodf(float x, float y) {
 	return (x - y * (int)(x / y));
 }
 
+struct Sine {
+	float operator()(float x) const { return fastmath::sin(x); }
+	simd::float4 operator()(simd::float4 x) const { return fastmath::sin(x); }
+};
+
 #define DO_OSC_SYNC(__osc_rads__) \
-	if (mSyncEnabled) { \
+	if (kSync) { \
 		mSyncRads = mSyncRads + twopi_rate * mSyncFrequency; \
 		if (mSyncRads >= m::twoPi) { \
 			mSyncRads -= m::twoPi; \
@@ -42,11 +51,11 @@ static inline float ffmodf(float x, float y) {
 		} \
 	}
 
-void Oscillator::SetWaveform	(Waveform w)			{ waveform = w; }
+void Oscillator::SetWaveform	(Waveform w)			{ waveform = w; updateRenderer(); }
 void Oscillator::reset			()						{ rads = 0.0; }
 
 void
-Oscillator::SetSampleRate(int rateIn)
+Oscillator::SetSampleRate(float rateIn)
 {
 	rate = rateIn;
 	twopi_rate = m::twoPi / rate;
@@ -66,28 +75,44 @@ Oscillator::ProcessSamples	(float *buffer, int nFrames, float freq_hz, float pw,
 	mFrequency.configure(mFrequency.getFinalValue(), std::min(freq_hz, maxFreq), nFrames);
 	mPulseWidth = pw;
 	mSyncFrequency = sync_freq;
-	
-	switch (waveform) {
-	case Waveform::kSine:     doSine      (buffer, nFrames); break;
-	case Waveform::kPulse:    doSquare    (buffer, nFrames); break;
-	case Waveform::kSaw:      doSaw       (buffer, nFrames); break;
-	case Waveform::kNoise:    doNoise     (buffer, nFrames); break;
-	case Waveform::kRandom:   doRandom    (buffer, nFrames); break;
-	default: assert(nullptr == "invalid waveform");
+
+	(this->*mRenderer)(buffer, nFrames);
+}
+
+void
+Oscillator::updateRenderer()
+{
+	static const Renderer renderers[][2] = {
+		{ &Oscillator::doSine<false>,   &Oscillator::doSine<true>   }, // kSine
+		{ &Oscillator::doSquare<false>, &Oscillator::doSquare<true> }, // kPulse
+		{ &Oscillator::doSaw<false>,    &Oscillator::doSaw<true>    }, // kSaw
+		{ &Oscillator::doNoise,         &Oscillator::doNoise        }, // kNoise
+		{ &Oscillator::doRandom,        &Oscillator::doRandom       }, // kRandom
+	};
+	assert((int) waveform < (int) (sizeof(renderers) / sizeof(renderers[0])));
+
+	if (mBandLimited && (waveform == Waveform::kSine || waveform == Waveform::kPulse || waveform == Waveform::kSaw)) {
+		mRenderer = mSyncEnabled ? &Oscillator::doBandLimited<true> : &Oscillator::doBandLimited<false>;
+	} else {
+		mRenderer = renderers[(int) waveform][mSyncEnabled];
 	}
 }
 
+template <bool kSync>
 void
 Oscillator::doSine(float *buffer, int nFrames)
 {
-    for (int i = 0; i < nFrames; i++) {
+	// the phase is accumulated first so that the sine loop can be vectorized
+	for (int i = 0; i < nFrames; i++) {
 		DO_OSC_SYNC(rads);
-		buffer[i] = sinf(rads += twopi_rate * mFrequency.nextValue());
+		buffer[i] = rads += twopi_rate * mFrequency.nextValue();
 	}
+	fastmath::transform(buffer, nFrames, Sine());
 	rads = ffmodf(rads, m::twoPi);			// overflows are bad!
 }
 
-void 
+template <bool kSync>
+void
 Oscillator::doSquare(float *buffer, int nFrames)
 {
 	const float radsper = twopi_rate * mFrequency.getFinalValue();
@@ -149,7 +174,8 @@ static inline float saw(float rads, float shape)
 	return (1 - 2 * t) / (1 - a);
 }
 
-void 
+template <bool kSync>
+void
 Oscillator::doSaw(float *buffer, int nFrames)
 {
 #ifdef ALIAS_REDUCTION
@@ -173,15 +199,121 @@ Oscillator::doSaw(float *buffer, int nFrames)
 #endif
 }
 
-static const float kTwoOverUlongMax = 2.0f / (float)ULONG_MAX;
+// wraps a non-negative phase (in cycles) into [0, 1)
+static inline float wrap(float t)
+{
+	return t - (int) t;
+}
 
-static inline float randf()
+template <bool kSync>
+void
+Oscillator::doBandLimited(float *buffer, int nFrames)
 {
-	// Calculate pseudo-random 32 bit number based on linear congruential method.
-	// http://www.musicdsp.org/showone.php?id=59
-	static unsigned long random = 22222;
-	random = (random * 196314165) + 907633515;
-	return (float)random * kTwoOverUlongMax - 1.0f;
+	// One table level for the whole block, chosen for the highest frequency
+	// it reaches so that a rising glide doesn't alias on the way up
+	const float maxFreq = std::max(mFrequency.getValue(), mFrequency.getFinalValue());
+	const int level = Wavetable::levelForIncrement(maxFreq / rate);
+
+	// First pass: the phase of each sample, in cycles. It is accumulated as
+	// a 32-bit fixed point fraction, which wraps around for free and leaves
+	// just an integer add in the loop carried dependency.
+	const float scale = 4294967296.0f / rate;
+	const float first = mFrequency.getValue() * scale;
+	const float step = (mFrequency.getFinalValue() * scale - first) / nFrames;
+	uint32_t phase = (uint32_t)(int64_t)((double)rads / m::twoPi * 4294967296.0);
+	for (int i = 0; i < nFrames; i++) {
+		DO_OSC_SYNC(phase);
+		phase += (uint32_t)(first + step * i);
+		buffer[i] = (float)(phase >> 8) * (1.0f / 16777216.0f);
+	}
+	rads = (float)(phase * (m::twoPi / 4294967296.0));
+
+	// Second pass: branch-free table lookups
+	switch (waveform) {
+	case Waveform::kSine: {
+		const float *table = Wavetable::sine().level(0);
+		for (int i = 0; i < nFrames; i++)
+			buffer[i] = Wavetable::lookup(table, buffer[i]);
+		break;
+	}
+	case Waveform::kPulse: {
+		// A pulse is the difference of two saws, offset by the duty cycle
+		const float *table = Wavetable::saw().level(level);
+		const float duty = 0.5f + 0.5f * std::min(mPulseWidth, 0.9f);
+		const float offset = 1.0f - duty;
+		const float dc = 2.0f * duty - 1.0f;
+		for (int i = 0; i < nFrames; i++) {
+			const float t = buffer[i];
+			buffer[i] = Wavetable::lookup(table, wrap(t + offset)) - Wavetable::lookup(table, t) + dc;
+		}
+		break;
+	}
+	case Waveform::kSaw: {
+		// The shape morphs from a falling saw (-1) through a triangle (0) to
+		// a rising saw (+1). The triangles are the difference of two
+		// parabolas, the integral of the difference of two saws, scaled to
+		// peak at +/- 1. Near the ends that scaling loses precision, so the
+		// saws are used directly.
+		const float a = (mPulseWidth + 1.0f) / 2.0f;
+		if (a > 0.99f) {
+			const float *table = Wavetable::saw().level(level);
+			for (int i = 0; i < nFrames; i++)
+				buffer[i] = Wavetable::lookup(table, wrap(buffer[i] + 0.5f)) * mPolarity;
+		} else if (a < 0.01f) {
+			const float *table = Wavetable::saw().level(level);
+			for (int i = 0; i < nFrames; i++)
+				buffer[i] = Wavetable::lookup(table, buffer[i]) * -mPolarity;
+		} else {
+			const float *table = Wavetable::parabola().level(level);
+			const float gain = mPolarity / (a * (1.0f - a));
+			const float lag = 1.0f - a / 2.0f, lead = a / 2.0f;
+			for (int i = 0; i < nFrames; i++) {
+				const float t = buffer[i];
+				buffer[i] = (Wavetable::lookup(table, wrap(t + lag)) - Wavetable::lookup(table, wrap(t + lead))) * gain;
+			}
+		}
+		break;
+	}
+	default: assert(nullptr == "waveform has no band-limited table");
+	}
+}
+
+// Four independent xorshift32 generators, one per lane
+static inline simd::int4 xorshift(simd::int4 x)
+{
+	x = x ^ (x << 13);
+	x = x ^ simd::shiftRightLogical(x, 17);
+	return x ^ (x << 5);
+}
+
+// The top 24 bits of each lane, as a float in [-1, 1)
+static inline simd::float4 toBipolar(simd::int4 x)
+{
+	return simd::toFloat(x >> 8) * (1.0f / 8388608.0f);
+}
+
+void
+Oscillator::setRandomSeed(uint32_t seed)
+{
+	// Hash each lane's seed (murmur3's finalizer) so that consecutive
+	// seeds give unrelated sequences
+	for (int i = 0; i < 4; i++) {
+		uint32_t z = seed * 4 + i + 0x9e3779b9;
+		z = (z ^ (z >> 16)) * 0x85ebca6b;
+		z = (z ^ (z >> 13)) * 0xc2b2ae35;
+		z ^= z >> 16;
+		mNoiseState[i] = z ? (int32_t) z : 1; // xorshift gets stuck at 0
+	}
+}
+
+float
+Oscillator::nextRandom()
+{
+	const simd::int4 state = xorshift(simd::load(mNoiseState));
+	simd::store(mNoiseState, state);
+	float values[4];
+	simd::store(values, toBipolar(state));
+	return values[0];
 }
 
 void 
@@ -191,7 +323,7 @@ Oscillator::doRandom(float *buffer, int nFrames)
     for (int i = 0; i < nFrames; i++) {
 	if (random_count > period) {
 	    random_count = 0;
-		random = randf();
+		random = nextRandom();
 	}
 	random_count++;
 	buffer[i] = random;
@@ -201,6 +333,18 @@ Oscillator::doRandom(float *buffer, int nFrames)
 void 
 Oscillator::doNoise(float *buffer, int nFrames)
 {
-    for (int i = 0; i < nFrames; i++)
-		buffer[i] = randf();
+	simd::int4 state = simd::load(mNoiseState);
+	int i = 0;
+	for (; i + 4 <= nFrames; i += 4) {
+		state = xorshift(state);
+		simd::store(buffer + i, toBipolar(state));
+	}
+	if (i < nFrames) {
+		float values[4];
+		state = xorshift(state);
+		simd::store(values, toBipolar(state));
+		for (int j = 0; i < nFrames; i++, j++)
+			buffer[i] = values[j];
+	}
+	simd::store(mNoiseState, state);
 }
@@ -24,6 +24,8 @@
 
 #include "Synth--.h"
 
+#include <cstdint>
+
 /**
  * @brief An Audio Oscillator unit.
  * 
@@ -41,7 +43,9 @@ public:
 		kRandom
 	};
 
-	void	SetSampleRate	(int rateIn);
+	Oscillator() { setRandomSeed(0); updateRenderer(); }
+
+	void	SetSampleRate	(float rateIn);
 	
 	void	ProcessSamples		(float*, int, float freq_hz, float pw, float sync_freq = 0);
 
@@ -50,14 +54,28 @@ public:
 
 	void reset();
 	
-	void	setSyncEnabled(bool sync) { mSyncEnabled = sync; }
+	void	setSyncEnabled(bool sync) { mSyncEnabled = sync; updateRenderer(); }
 	void	setPolarity (float polarity); // +1 or -1
 
+	/**
+	 * Restarts the noise and random waveforms from a sequence determined by
+	 * seed. Each oscillator has its own generator, so oscillators given
+	 * different seeds are uncorrelated and can run on different threads.
+	 */
+	void	setRandomSeed (uint32_t seed);
+
+	/**
+	 * Renders the sine, pulse and saw waveforms from the band-limited
+	 * tables in Wavetable.h rather than computing them directly. Call
+	 * Wavetable::prepare() before enabling this on the audio thread.
+	 */
+	void	setBandLimited (bool enabled) { mBandLimited = enabled; updateRenderer(); }
+
 private:
     float rads = 0;
 	float twopi_rate = 0;
 	float random = 0;
-    int rate = 44100;
+    float rate = 44100;
 	int random_count = 0;
 
 	Waveform waveform = Waveform::kSine;
@@ -68,12 +86,28 @@ private:
 	float	mSyncFrequency = 0;
 	bool	mSyncEnabled = false;
 	double	mSyncRads = 0;
-	
-    void doSine(float*, int nFrames);
-    void doSquare(float*, int nFrames);
-    void doSaw(float*, int nFrames);
+
+	bool	mBandLimited = false;
+
+	int32_t	mNoiseState[4];
+
+	// The waveform's render function, specialized for whether sync is on
+	// so that the per-sample loops don't test it. Chosen by updateRenderer()
+	// whenever the waveform, sync or band-limiting changes.
+	typedef void (Oscillator::*Renderer)(float*, int nFrames);
+	Renderer mRenderer;
+
+	void updateRenderer();
+
+	template <bool kSync> void doSine(float*, int nFrames);
+	template <bool kSync> void doSquare(float*, int nFrames);
+	template <bool kSync> void doSaw(float*, int nFrames);
     void doNoise(float*, int nFrames);
 	void doRandom(float*, int nFrames);
+
+	template <bool kSync> void doBandLimited(float*, int nFrames);
+
+	float nextRandom();
 };
 
 #endif				/// _OSCILLATOR_H
@@ -0,0 +1,61 @@
+/*
+ *  PatchParameters.h
+ *
+ *  Copyright (c) 2022 Nick Dowell
+ *
+ *  This file is part of amsynth.
+ *
+ *  amsynth is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  amsynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with amsynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _PATCHPARAMETERS_H
+#define _PATCHPARAMETERS_H
+
+#include "../controls.h"
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * The control values of the current patch, shared by all voices.
+ *
+ * Every change is stamped with a new version number, so a voice can catch
+ * up with all the changes made since it last looked (see
+ * VoiceBoard::syncParameters) instead of each change being pushed to every
+ * voice as it happens.
+ *
+ * set() may be called from any thread while the audio thread syncs voices:
+ * a parameter's value and version are stored before the new version is
+ * published, so every version up to that read is complete.
+ */
+struct PatchParameters
+{
+	std::atomic<float>		values[kAmsynthParameterCount] = {};
+	std::atomic<uint64_t>	versions[kAmsynthParameterCount] = {};
+	std::atomic<uint64_t>	version{0};
+
+	void set(Param param, float value)
+	{
+		if (versions[param].load(std::memory_order_relaxed) &&
+			values[param].load(std::memory_order_relaxed) == value)
+			return;
+		values[param].store(value, std::memory_order_relaxed);
+		uint64_t current = version.load(std::memory_order_relaxed);
+		do {
+			versions[param].store(current + 1, std::memory_order_release);
+		} while (!version.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel));
+	}
+};
+
+#endif
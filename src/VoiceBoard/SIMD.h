@@ -0,0 +1,210 @@
+/*
+ *  SIMD.h
+ *
+ *  Copyright (c) 2022 Nick Dowell
+ *
+ *  This file is part of amsynth.
+ *
+ *  amsynth is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  amsynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with amsynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SIMD_H
+#define _SIMD_H
+
+//
+// Minimal portable wrappers around the SIMD types used by the voice bank
+// and FastMath.h. Every operation other than transpose() is element-wise,
+// so the results are identical to the equivalent scalar code.
+//
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define AMSYNTH_SIMD_SSE2 1
+#include <emmintrin.h>
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define AMSYNTH_SIMD_NEON 1
+#include <arm_neon.h>
+#endif
+
+namespace simd {
+
+#if defined(AMSYNTH_SIMD_SSE2)
+
+struct float4 {
+	__m128 v;
+	float4() = default;
+	float4(__m128 v) : v(v) {}
+	float4(float x) : v(_mm_set1_ps(x)) {}
+};
+struct int4 {
+	__m128i v;
+	int4() = default;
+	int4(__m128i v) : v(v) {}
+	int4(int32_t x) : v(_mm_set1_epi32(x)) {}
+};
+struct mask4 { __m128 v; };
+
+inline float4 load(const float *p) { return _mm_loadu_ps(p); }
+inline void store(float *p, float4 a) { _mm_storeu_ps(p, a.v); }
+
+inline float4 operator+(float4 a, float4 b) { return _mm_add_ps(a.v, b.v); }
+inline float4 operator-(float4 a, float4 b) { return _mm_sub_ps(a.v, b.v); }
+inline float4 operator*(float4 a, float4 b) { return _mm_mul_ps(a.v, b.v); }
+inline float4 operator/(float4 a, float4 b) { return _mm_div_ps(a.v, b.v); }
+inline float4 min(float4 a, float4 b) { return _mm_min_ps(a.v, b.v); }
+inline float4 max(float4 a, float4 b) { return _mm_max_ps(a.v, b.v); }
+inline float4 abs(float4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.f), a.v); }
+inline float4 copysign(float4 a, float4 b) { const __m128 sign = _mm_set1_ps(-0.f); return _mm_or_ps(_mm_andnot_ps(sign, a.v), _mm_and_ps(sign, b.v)); }
+
+inline mask4 operator<(float4 a, float4 b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline mask4 operator>(float4 a, float4 b) { return { _mm_cmpgt_ps(a.v, b.v) }; }
+inline float4 select(mask4 m, float4 a, float4 b) { return _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)); }
+
+/** Transposes the 4x4 matrix whose rows are a, b, c and d */
+inline void transpose(float4 &a, float4 &b, float4 &c, float4 &d) { _MM_TRANSPOSE4_PS(a.v, b.v, c.v, d.v); }
+
+inline int4 truncate(float4 a) { return _mm_cvttps_epi32(a.v); }
+inline float4 toFloat(int4 a) { return _mm_cvtepi32_ps(a.v); }
+inline int4 bitsOf(float4 a) { return _mm_castps_si128(a.v); }
+inline float4 fromBits(int4 a) { return _mm_castsi128_ps(a.v); }
+
+inline int4 operator+(int4 a, int4 b) { return _mm_add_epi32(a.v, b.v); }
+inline int4 operator-(int4 a, int4 b) { return _mm_sub_epi32(a.v, b.v); }
+inline int4 operator<<(int4 a, int n) { return _mm_slli_epi32(a.v, n); }
+inline int4 operator>>(int4 a, int n) { return _mm_srai_epi32(a.v, n); }
+inline int4 operator^(int4 a, int4 b) { return _mm_xor_si128(a.v, b.v); }
+inline int4 shiftRightLogical(int4 a, int n) { return _mm_srli_epi32(a.v, n); }
+inline int4 load(const int32_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+inline void store(int32_t *p, int4 a) { _mm_storeu_si128((__m128i *)p, a.v); }
+
+#elif defined(AMSYNTH_SIMD_NEON)
+
+struct float4 {
+	float32x4_t v;
+	float4() = default;
+	float4(float32x4_t v) : v(v) {}
+	float4(float x) : v(vdupq_n_f32(x)) {}
+};
+struct int4 {
+	int32x4_t v;
+	int4() = default;
+	int4(int32x4_t v) : v(v) {}
+	int4(int32_t x) : v(vdupq_n_s32(x)) {}
+};
+struct mask4 { uint32x4_t v; };
+
+inline float4 load(const float *p) { return vld1q_f32(p); }
+inline void store(float *p, float4 a) { vst1q_f32(p, a.v); }
+
+inline float4 operator+(float4 a, float4 b) { return vaddq_f32(a.v, b.v); }
+inline float4 operator-(float4 a, float4 b) { return vsubq_f32(a.v, b.v); }
+inline float4 operator*(float4 a, float4 b) { return vmulq_f32(a.v, b.v); }
+inline float4 operator/(float4 a, float4 b) { return vdivq_f32(a.v, b.v); }
+inline float4 min(float4 a, float4 b) { return vminq_f32(a.v, b.v); }
+inline float4 max(float4 a, float4 b) { return vmaxq_f32(a.v, b.v); }
+inline float4 abs(float4 a) { return vabsq_f32(a.v); }
+inline float4 copysign(float4 a, float4 b) { return vbslq_f32(vdupq_n_u32(0x80000000), b.v, a.v); }
+
+inline mask4 operator<(float4 a, float4 b) { return { vcltq_f32(a.v, b.v) }; }
+inline mask4 operator>(float4 a, float4 b) { return { vcgtq_f32(a.v, b.v) }; }
+inline float4 select(mask4 m, float4 a, float4 b) { return vbslq_f32(m.v, a.v, b.v); }
+
+inline void transpose(float4 &a, float4 &b, float4 &c, float4 &d)
+{
+	const float32x4x2_t ab = vtrnq_f32(a.v, b.v), cd = vtrnq_f32(c.v, d.v);
+	a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+	b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+	c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+	d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+
+inline int4 truncate(float4 a) { return vcvtq_s32_f32(a.v); }
+inline float4 toFloat(int4 a) { return vcvtq_f32_s32(a.v); }
+inline int4 bitsOf(float4 a) { return vreinterpretq_s32_f32(a.v); }
+inline float4 fromBits(int4 a) { return vreinterpretq_f32_s32(a.v); }
+
+inline int4 operator+(int4 a, int4 b) { return vaddq_s32(a.v, b.v); }
+inline int4 operator-(int4 a, int4 b) { return vsubq_s32(a.v, b.v); }
+inline int4 operator<<(int4 a, int n) { return vshlq_s32(a.v, vdupq_n_s32(n)); }
+inline int4 operator>>(int4 a, int n) { return vshlq_s32(a.v, vdupq_n_s32(-n)); }
+inline int4 operator^(int4 a, int4 b) { return veorq_s32(a.v, b.v); }
+inline int4 shiftRightLogical(int4 a, int n) { return vreinterpretq_s32_u32(vshlq_u32(vreinterpretq_u32_s32(a.v), vdupq_n_s32(-n))); }
+inline int4 load(const int32_t *p) { return vld1q_s32(p); }
+inline void store(int32_t *p, int4 a) { vst1q_s32(p, a.v); }
+
+#else
+
+struct float4 {
+	float v[4];
+	float4() = default;
+	float4(float x) : v{x, x, x, x} {}
+};
+struct int4 {
+	int32_t v[4];
+	int4() = default;
+	int4(int32_t x) : v{x, x, x, x} {}
+};
+struct mask4 { bool v[4]; };
+
+#define AMSYNTH_SIMD_MAP(T, expression) T r; for (int i = 0; i < 4; i++) r.v[i] = (expression); return r
+
+inline float4 load(const float *p) { AMSYNTH_SIMD_MAP(float4, p[i]); }
+inline void store(float *p, float4 a) { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+
+inline float4 operator+(float4 a, float4 b) { AMSYNTH_SIMD_MAP(float4, a.v[i] + b.v[i]); }
+inline float4 operator-(float4 a, float4 b) { AMSYNTH_SIMD_MAP(float4, a.v[i] - b.v[i]); }
+inline float4 operator*(float4 a, float4 b) { AMSYNTH_SIMD_MAP(float4, a.v[i] * b.v[i]); }
+inline float4 operator/(float4 a, float4 b) { AMSYNTH_SIMD_MAP(float4, a.v[i] / b.v[i]); }
+inline float4 min(float4 a, float4 b) { AMSYNTH_SIMD_MAP(float4, a.v[i] < b.v[i] ? a.v[i] : b.v[i]); }
+inline float4 max(float4 a, float4 b) { AMSYNTH_SIMD_MAP(float4, a.v[i] > b.v[i] ? a.v[i] : b.v[i]); }
+inline float4 abs(float4 a) { AMSYNTH_SIMD_MAP(float4, std::fabs(a.v[i])); }
+inline float4 copysign(float4 a, float4 b) { AMSYNTH_SIMD_MAP(float4, std::copysign(a.v[i], b.v[i])); }
+
+inline mask4 operator<(float4 a, float4 b) { AMSYNTH_SIMD_MAP(mask4, a.v[i] < b.v[i]); }
+inline mask4 operator>(float4 a, float4 b) { AMSYNTH_SIMD_MAP(mask4, a.v[i] > b.v[i]); }
+inline float4 select(mask4 m, float4 a, float4 b) { AMSYNTH_SIMD_MAP(float4, m.v[i] ? a.v[i] : b.v[i]); }
+
+inline void transpose(float4 &a, float4 &b, float4 &c, float4 &d)
+{
+	float4 *rows[4] = { &a, &b, &c, &d };
+	for (int i = 0; i < 4; i++)
+		for (int j = i + 1; j < 4; j++)
+			std::swap(rows[i]->v[j], rows[j]->v[i]);
+}
+
+inline int4 truncate(float4 a) { AMSYNTH_SIMD_MAP(int4, (int32_t)a.v[i]); }
+inline float4 toFloat(int4 a) { AMSYNTH_SIMD_MAP(float4, (float)a.v[i]); }
+inline int4 bitsOf(float4 a) { int4 r; memcpy(r.v, a.v, sizeof r.v); return r; }
+inline float4 fromBits(int4 a) { float4 r; memcpy(r.v, a.v, sizeof r.v); return r; }
+
+inline int4 operator+(int4 a, int4 b) { AMSYNTH_SIMD_MAP(int4, (int32_t)((uint32_t)a.v[i] + (uint32_t)b.v[i])); }
+inline int4 operator-(int4 a, int4 b) { AMSYNTH_SIMD_MAP(int4, (int32_t)((uint32_t)a.v[i] - (uint32_t)b.v[i])); }
+inline int4 operator<<(int4 a, int n) { AMSYNTH_SIMD_MAP(int4, (int32_t)((uint32_t)a.v[i] << n)); }
+inline int4 operator>>(int4 a, int n) { AMSYNTH_SIMD_MAP(int4, a.v[i] >> n); }
+inline int4 operator^(int4 a, int4 b) { AMSYNTH_SIMD_MAP(int4, a.v[i] ^ b.v[i]); }
+inline int4 shiftRightLogical(int4 a, int n) { AMSYNTH_SIMD_MAP(int4, (int32_t)((uint32_t)a.v[i] >> n)); }
+inline int4 load(const int32_t *p) { AMSYNTH_SIMD_MAP(int4, p[i]); }
+inline void store(int32_t *p, int4 a) { for (int i = 0; i < 4; i++) p[i] = a.v[i]; }
+
+#undef AMSYNTH_SIMD_MAP
+
+#endif
+
+} // namespace simd
+
+#endif
@@ -138,6 +138,11 @@ public:
 	{
 		_z = z;
 	}
+
+	inline float getValue() const
+	{
+		return _z;
+	}
 	
 private:
 	float _z;
@@ -162,7 +167,7 @@ public:
 		return *this;
 	}
 	
-	float getRawValue()
+	float getRawValue() const
 	{
 		return _rawValue;
 	}
@@ -176,6 +181,19 @@ public:
 	{
 		return _smoother.processSample(_rawValue);
 	}
+
+	/**
+	 * The smoother only approaches its target, so this finishes the job once
+	 * it is within tolerance, letting callers skip the per-sample ticks.
+	 * @return true if the smoothed value is (now) equal to the raw value
+	 */
+	bool settle(float tolerance)
+	{
+		if (std::fabs(_smoother.getValue() - _rawValue) > tolerance)
+			return false;
+		reset();
+		return true;
+	}
 	
 private:
 	
@@ -23,14 +23,22 @@
 
 #include <cassert>
 #include <cmath>
+#include <initializer_list>
 
 #define BLEND(x0, x1, m) (((x0) * (1.f - (m))) + ((x1) * (m)))
 
+constexpr int VoiceBoard::kMaxBankSize;
+constexpr int VoiceBoard::kMaxControlPeriod;
+
 // Low-pass filter the VCA control signal to prevent nasty clicking sounds
 const float kVCALowPassFreq = 4000.0f;
 
 const float kKeyTrackBaseFreq = 261.626f; // Middle C
 
+// Smoothed parameters this close to their targets are snapped to them, so
+// that the blocks in between can use the specialized kernels below
+const float kSettledTolerance = 1e-6f;
+
 enum class LFOWaveform {
 	kSine,
 	kSquare,
@@ -41,26 +49,73 @@ enum class LFOWaveform {
 	kSawtoothDown
 };
 
+//
+// Kernels for the common case of parameters that aren't moving. They are
+// specialized on the settings that would otherwise be tested every sample,
+// and have no loop-carried dependencies so that they vectorize.
+//
+
+template <bool kRingMod>
+static void mixOscillators(float *osc1, const float *osc2, int numSamples, float osc1vol, float osc2vol, float ringMod)
+{
+	for (int i=0; i<numSamples; i++) {
+		float y = osc1vol * osc1[i] + osc2vol * osc2[i];
+		if (kRingMod)
+			y += ringMod * osc1[i] * osc2[i];
+		osc1[i] = y;
+	}
+}
+
+template <bool kAmpMod>
+static void scaleAmplitude(float *env, const float *lfo, int numSamples, float gain, float lfoScale, float lfoOffset)
+{
+	for (int i=0; i<numSamples; i++) {
+		env[i] *= kAmpMod ? gain * (lfo[i] * lfoScale + lfoOffset) : gain;
+	}
+}
+
+typedef void (*OscillatorMixer)(float *, const float *, int, float, float, float);
+typedef void (*AmplitudeScaler)(float *, const float *, int, float, float, float);
+
+static const OscillatorMixer kOscillatorMixers[] = { mixOscillators<false>, mixOscillators<true> };
+static const AmplitudeScaler kAmplitudeScalers[] = { scaleAmplitude<false>, scaleAmplitude<true> };
+
+// Shared by the voices' LFOs and the global one
+static void setLFOWaveform(Oscillator &lfo, float &pulseWidth, float value)
+{
+	switch ((LFOWaveform)(int)value) {
+		case LFOWaveform::kSine:         pulseWidth = 0.0; lfo.SetWaveform(Oscillator::Waveform::kSine);   break;
+		case LFOWaveform::kSquare:       pulseWidth = 0.0; lfo.SetWaveform(Oscillator::Waveform::kPulse);  break;
+		case LFOWaveform::kTriangle:     pulseWidth = 0.0; lfo.SetWaveform(Oscillator::Waveform::kSaw);    break;
+		case LFOWaveform::kNoise:        pulseWidth = 0.0; lfo.SetWaveform(Oscillator::Waveform::kNoise);  break;
+		case LFOWaveform::kRandomize:    pulseWidth = 0.0; lfo.SetWaveform(Oscillator::Waveform::kRandom); break;
+		case LFOWaveform::kSawtoothUp:   pulseWidth = 1.0; lfo.SetWaveform(Oscillator::Waveform::kSaw);    lfo.setPolarity(+1.0); break;
+		case LFOWaveform::kSawtoothDown: pulseWidth = 1.0; lfo.SetWaveform(Oscillator::Waveform::kSaw);    lfo.setPolarity(-1.0); break;
+		default: assert(nullptr == "invalid LFO waveform"); break;
+	}
+}
+
+void
+VoiceBoard::syncParameters(const PatchParameters &parameters)
+{
+	// Read first, so a change made during the scan is picked up next time
+	const uint64_t version = parameters.version.load(std::memory_order_acquire);
+	if (mParametersVersion == version)
+		return;
+	for (int i = 0; i < kAmsynthParameterCount; i++) {
+		if (parameters.versions[i].load(std::memory_order_acquire) > mParametersVersion)
+			UpdateParameter((Param) i, parameters.values[i].load(std::memory_order_relaxed));
+	}
+	mParametersVersion = version;
+}
+
 void
 VoiceBoard::UpdateParameter	(Param param, float value)
 {
 	switch (param)
 	{
-	case kAmsynthParameter_LFOToAmp:	mAmpModAmount = (value+1.0f)/2.0f;break;
 	case kAmsynthParameter_LFOFreq:		mLFO1Freq = value; 		break;
-	case kAmsynthParameter_LFOWaveform: {
-		switch ((LFOWaveform)(int)value) {
-			case LFOWaveform::kSine:         mLFOPulseWidth = 0.0; lfo1.SetWaveform(Oscillator::Waveform::kSine);   break;
-			case LFOWaveform::kSquare:       mLFOPulseWidth = 0.0; lfo1.SetWaveform(Oscillator::Waveform::kPulse);  break;
-			case LFOWaveform::kTriangle:     mLFOPulseWidth = 0.0; lfo1.SetWaveform(Oscillator::Waveform::kSaw);    break;
-			case LFOWaveform::kNoise:        mLFOPulseWidth = 0.0; lfo1.SetWaveform(Oscillator::Waveform::kNoise);  break;
-			case LFOWaveform::kRandomize:    mLFOPulseWidth = 0.0; lfo1.SetWaveform(Oscillator::Waveform::kRandom); break;
-			case LFOWaveform::kSawtoothUp:   mLFOPulseWidth = 1.0; lfo1.SetWaveform(Oscillator::Waveform::kSaw);    lfo1.setPolarity(+1.0); break;
-			case LFOWaveform::kSawtoothDown: mLFOPulseWidth = 1.0; lfo1.SetWaveform(Oscillator::Waveform::kSaw);    lfo1.setPolarity(-1.0); break;
-			default: assert(nullptr == "invalid LFO waveform"); break;
-		}
-		break;
-	}
+	case kAmsynthParameter_LFOWaveform:	setLFOWaveform(lfo1, mLFOPulseWidth, value); break;
 	case kAmsynthParameter_LFOToOscillators:	mFreqModAmount=(value/2.0f)+0.5f;	break;
     case kAmsynthParameter_LFOOscillatorSelect: mFreqModDestination = (int)roundf(value); break;
 	
@@ -88,16 +143,18 @@ VoiceBoard::UpdateParameter	(Param param, float value)
 	case kAmsynthParameter_FilterKeyTrackAmount: mFilterKbdTrack = value; break;
 	case kAmsynthParameter_FilterKeyVelocityAmount: mFilterVelSens = value; break;
 
-	case kAmsynthParameter_OscillatorMixRingMod:	mRingModAmt = value;		break;
-	case kAmsynthParameter_OscillatorMix:			mOscMix = value;			break;
-	
 	case kAmsynthParameter_AmpEnvAttack:			mAmpADSR.SetAttack(value);	break;
 	case kAmsynthParameter_AmpEnvDecay:				mAmpADSR.SetDecay(value);	break;
 	case kAmsynthParameter_AmpEnvSustain:			mAmpADSR.SetSustain(value);	break;
 	case kAmsynthParameter_AmpEnvRelease:			mAmpADSR.SetRelease(value);	break;
-	case kAmsynthParameter_AmpVelocityAmount: mAmpVelSens = value; break;
 		
+	// smoothed for all voices by SharedRamps
+	case kAmsynthParameter_LFOToAmp:
+	case kAmsynthParameter_OscillatorMixRingMod:
+	case kAmsynthParameter_OscillatorMix:
+	case kAmsynthParameter_AmpVelocityAmount:
 	case kAmsynthParameter_MasterVolume:
+	case kAmsynthParameter_LFOMode:
 	case kAmsynthParameter_ReverbRoomsize:
 	case kAmsynthParameter_ReverbDamp:
 	case kAmsynthParameter_ReverbWet:
@@ -113,6 +170,55 @@ VoiceBoard::UpdateParameter	(Param param, float value)
 	}
 }
 
+void
+VoiceBoard::SharedRamps::UpdateParameter	(Param param, float value)
+{
+	switch (param)
+	{
+	case kAmsynthParameter_LFOToAmp:				mAmpModAmount.param = (value+1.0f)/2.0f;	break;
+	case kAmsynthParameter_OscillatorMixRingMod:	mRingModAmt.param = value;	break;
+	case kAmsynthParameter_OscillatorMix:			mOscMix.param = value;		break;
+	case kAmsynthParameter_AmpVelocityAmount:		mAmpVelSens.param = value;	break;
+	case kAmsynthParameter_MasterVolume:			mVolume.param = value;		break;
+	case kAmsynthParameter_LFOFreq:					mLFOFreq = value;			break;
+	case kAmsynthParameter_LFOWaveform:				setLFOWaveform(mLFO, mLFOPulseWidth, value); break;
+	case kAmsynthParameter_LFOMode:					mGlobalLFO = (int) value == LFOModeGlobal; break;
+	default:
+		assert(nullptr == "not a shared parameter");
+	}
+}
+
+void
+VoiceBoard::SharedRamps::process	(int numSamples)
+{
+	assert(numSamples <= kMaxProcessBufferSize);
+	mOscMix.process(numSamples);
+	mRingModAmt.process(numSamples);
+	mAmpModAmount.process(numSamples);
+	mAmpVelSens.process(numSamples);
+	mVolume.process(numSamples);
+	if (mGlobalLFO)
+		mLFO.ProcessSamples(mLFOValues, numSamples, mLFOFreq, mLFOPulseWidth);
+}
+
+void
+VoiceBoard::SharedRamps::reset	()
+{
+	for (Ramp *ramp : { &mOscMix, &mRingModAmt, &mAmpModAmount, &mAmpVelSens, &mVolume }) {
+		ramp->param.reset();
+		ramp->settled = true;
+	}
+}
+
+void
+VoiceBoard::SharedRamps::Ramp::process	(int numSamples)
+{
+	// once settled, the smoother sits exactly on the raw value
+	settled = param.settle(kSettledTolerance);
+	for (int i=0; i<numSamples; i++)
+		values[i] = param.tick();
+}
+
 void
 VoiceBoard::SetPitchBend	(float val)
 {	
@@ -120,10 +226,67 @@ VoiceBoard::SetPitchBend	(float val)
 }
 
 void
-VoiceBoard::ProcessSamplesMix	(float *buffer, int numSamples, float vol)
+VoiceBoard::ProcessSamplesMix	(float *buffer, int numSamples, const SharedRamps &ramps, Workspace &workspace)
+{
+	assert(numSamples <= kMaxProcessBufferSize);
+
+	SynthFilter::Coefficients coefficients;
+	if (processOscillators(workspace, 0, numSamples, ramps, coefficients)) {
+		if (mSVFFilter) {
+			SynthFilter *filters[] = { &filter };
+			float *buffers[] = { workspace.osc_1[0] };
+			const float *cutoffs[] = { workspace.filter_cutoff[0] };
+			SynthFilter::ProcessSamples(filters, buffers, cutoffs, &mFilterRes, 1, numSamples, mFilterType, mFilterSlope);
+		} else {
+			filter.ProcessSamples(workspace.osc_1[0], numSamples, coefficients, mFilterSlope);
+		}
+	}
+	processAmplifier(workspace, 0, buffer, numSamples, ramps);
+}
+
+void
+VoiceBoard::ProcessSamplesMix	(VoiceBoard *voices[], int count, float *buffer, int numSamples, const SharedRamps &ramps, Workspace &workspace)
 {
+	assert(0 < count && count <= kMaxBankSize);
 	assert(numSamples <= kMaxProcessBufferSize);
 
+	SynthFilter *filters[kMaxBankSize];
+	float *buffers[kMaxBankSize];
+	SynthFilter::Coefficients coefficients[kMaxBankSize];
+	const float *cutoffs[kMaxBankSize];
+	float res[kMaxBankSize];
+	bool filtered = false;
+
+	for (int v = 0; v < count; v++) {
+		VoiceBoard *voice = voices[v];
+		filters[v] = &voice->filter;
+		buffers[v] = workspace.osc_1[v];
+		cutoffs[v] = workspace.filter_cutoff[v];
+		res[v] = voice->mFilterRes;
+		filtered = voice->processOscillators(workspace, v, numSamples, ramps, coefficients[v]);
+		// filter type and slope are patch settings, shared by all voices
+		assert(voice->mFilterType == voices[0]->mFilterType);
+		assert(voice->mFilterSlope == voices[0]->mFilterSlope);
+		assert(voice->mSVFFilter == voices[0]->mSVFFilter);
+	}
+
+	if (filtered) {
+		const VoiceBoard *first = voices[0];
+		if (first->mSVFFilter) {
+			SynthFilter::ProcessSamples(filters, buffers, cutoffs, res, count, numSamples, first->mFilterType, first->mFilterSlope);
+		} else {
+			SynthFilter::ProcessSamples(filters, buffers, coefficients, count, numSamples, first->mFilterSlope);
+		}
+	}
+
+	for (int v = 0; v < count; v++) {
+		voices[v]->processAmplifier(workspace, v, buffer, numSamples, ramps);
+	}
+}
+
+bool
+VoiceBoard::processOscillators	(Workspace &workspace, int lane, int numSamples, const SharedRamps &ramps, SynthFilter::Coefficients &coefficients)
+{
 	if (mFrequencyDirty) {
 		mFrequencyDirty = false;
 		mFrequency.configure(mFrequencyStart, mFrequencyTarget, (int) (mFrequencyTime * mSampleRate));
@@ -132,8 +295,14 @@ VoiceBoard::ProcessSamplesMix	(float *buffer, int numSamples, float vol)
 	//
 	// Control Signals
 	//
-	float *lfo1buf = mProcessBuffers.lfo_osc_1;
-	lfo1.ProcessSamples (lfo1buf, numSamples, mLFO1Freq, mLFOPulseWidth);
+	// The LFO and filter envelope run at the control rate, see setControlPeriod()
+	const int points = controlPoints(numSamples);
+	const float *lfo1buf = ramps.mLFOValues;
+	if (!ramps.mGlobalLFO) {
+		lfo1.ProcessSamples (workspace.control, points, mLFO1Freq, mLFOPulseWidth);
+		rampControl(workspace.control, workspace.lfo_osc_1[lane], numSamples, mLFORamp);
+		lfo1buf = workspace.lfo_osc_1[lane];
+	}
 
 	const float frequency = mFrequency.nextValue();
 	for (int i=1; i<numSamples; i++) { mFrequency.nextValue(); }
@@ -152,8 +321,13 @@ VoiceBoard::ProcessSamplesMix	(float *buffer, int numSamples, float vol)
 	}
 	float osc2pw = mOsc2PulseWidth;
 
-	mFilterADSR.process(mProcessBuffers.filter_env, numSamples);
-	float env_f = mProcessBuffers.filter_env[numSamples - 1];
+	mFilterADSR.process(workspace.control, points);
+	rampControl(workspace.control, workspace.filter_env, numSamples, mFilterEnvRamp);
+	if (mControlLeft >= numSamples)
+		mControlLeft -= numSamples;
+	else
+		mControlLeft = (mControlPeriod - (numSamples - mControlLeft) % mControlPeriod) % mControlPeriod;
+	float env_f = workspace.filter_env[numSamples - 1];
 	float cutoff_base = BLEND(kKeyTrackBaseFreq, frequency, mFilterKbdTrack);
 	float cutoff_vel_mult = BLEND(1.f, mKeyVelocity, mFilterVelSens);
 	float cutoff_lfo_mult = (lfo1buf[0] * 0.5f + 0.5f) * mFilterModAmt + 1 - mFilterModAmt;
@@ -165,12 +339,24 @@ VoiceBoard::ProcessSamplesMix	(float *buffer, int numSamples, float vol)
 		cutoff += cutoff * r16 * mFilterEnvAmt * env_f;
 	}
 	
+	if (mSVFFilter) {
+		// the same calculation for every sample rather than once per block
+		const float cutoff_fixed = mFilterCutoff * cutoff_base * cutoff_vel_mult;
+		const float lfo_scale = 0.5f * mFilterModAmt, lfo_offset = 1 - lfo_scale;
+		const float env_scale = mFilterEnvAmt > 0.f ? frequency * mFilterEnvAmt : 0.f;
+		const float env_mult = mFilterEnvAmt > 0.f ? 0.f : mFilterEnvAmt / 16.f;
+		float *cutoffbuf = workspace.filter_cutoff[lane];
+		for (int i=0; i<numSamples; i++) {
+			const float lfo_cutoff = cutoff_fixed * (lfo1buf[i] * lfo_scale + lfo_offset);
+			cutoffbuf[i] = lfo_cutoff * (1.f + env_mult * workspace.filter_env[i]) + env_scale * workspace.filter_env[i];
+		}
+	}
 
 	//
 	// VCOs
 	//
-	float *osc1buf = mProcessBuffers.osc_1;
-	float *osc2buf = mProcessBuffers.osc_2;
+	float *osc1buf = workspace.osc_1[lane];
+	float *osc2buf = workspace.osc_2;
 
 	bool osc2sync = mOsc2Sync;
 	// previous implementation of sync had a bug causing it to only work when osc1 was set to sine or saw
@@ -184,32 +370,89 @@ VoiceBoard::ProcessSamplesMix	(float *buffer, int numSamples, float vol)
 	//
 	// Osc Mix
 	//
-	for (int i=0; i<numSamples; i++) {
-		float ringMod = mRingModAmt.tick();
-		float oscMix = mOscMix.tick();
-		float osc1vol = (1.F - ringMod) * (1.F - oscMix) / 2.F;
-		float osc2vol = (1.F - ringMod) * (1.F + oscMix) / 2.F;
-		osc1buf[i] =
-			osc1vol * osc1buf[i] +
-			osc2vol * osc2buf[i] +
-			ringMod * osc1buf[i] * osc2buf[i];
+	const SharedRamps::Ramp &ringModRamp = ramps.mRingModAmt, &oscMixRamp = ramps.mOscMix;
+	if (ringModRamp.settled && oscMixRamp.settled) {
+		const float ringMod = ringModRamp.param.getRawValue();
+		const float oscMix = oscMixRamp.param.getRawValue();
+		const float osc1vol = (1.F - ringMod) * (1.F - oscMix) / 2.F;
+		const float osc2vol = (1.F - ringMod) * (1.F + oscMix) / 2.F;
+		kOscillatorMixers[ringMod != 0.f](osc1buf, osc2buf, numSamples, osc1vol, osc2vol, ringMod);
+	} else {
+		for (int i=0; i<numSamples; i++) {
+			float ringMod = ringModRamp.values[i];
+			float oscMix = oscMixRamp.values[i];
+			float osc1vol = (1.F - ringMod) * (1.F - oscMix) / 2.F;
+			float osc2vol = (1.F - ringMod) * (1.F + oscMix) / 2.F;
+			osc1buf[i] =
+				osc1vol * osc1buf[i] +
+				osc2vol * osc2buf[i] +
+				ringMod * osc1buf[i] * osc2buf[i];
+		}
 	}
 
 	//
-	// VCF
+	// VCF coefficients - the filter itself is run by the caller
 	//
-	filter.ProcessSamples (osc1buf, numSamples, cutoff, mFilterRes, mFilterType, mFilterSlope);
-	
+	if (mSVFFilter)
+		return mFilterType != SynthFilter::Type::kBypass;
+	return filter.calculateCoefficients(cutoff, mFilterRes, mFilterType, coefficients);
+}
+
+int
+VoiceBoard::controlPoints	(int numSamples) const
+{
+	return mControlLeft >= numSamples ? 0 : (numSamples - mControlLeft + mControlPeriod - 1) / mControlPeriod;
+}
+
+void
+VoiceBoard::rampControl	(const float *points, float *buffer, int numSamples, ControlRamp &ramp) const
+{
+	// Written so that a period of 1 gives the control values exactly
+	const float scale = 1.f / (float) mControlPeriod;
+	int left = mControlLeft;
+	for (int i=0; i<numSamples; i++) {
+		if (left == 0) {
+			ramp.step = (*points - ramp.target) * scale;
+			ramp.target = *points++;
+			left = mControlPeriod;
+		}
+		buffer[i] = ramp.target - ramp.step * (float) --left;
+	}
+}
+
+void
+VoiceBoard::processAmplifier	(Workspace &workspace, int lane, float *buffer, int numSamples, const SharedRamps &ramps)
+{
+	const float *osc1buf = workspace.osc_1[lane];
+	const float *lfo1buf = ramps.mGlobalLFO ? ramps.mLFOValues : workspace.lfo_osc_1[lane];
+
 	//
 	// VCA
 	// 
-	float *ampenvbuf = mProcessBuffers.amp_env;
+	float *ampenvbuf = workspace.amp_env;
 	mAmpADSR.process(ampenvbuf, numSamples);
-	for (int i=0; i<numSamples; i++) {
-		float ampModAmount = mAmpModAmount.tick();
-		const float amplitude = ampenvbuf[i] * BLEND(1.f, mKeyVelocity, mAmpVelSens.tick()) *
-			( ((lfo1buf[i] * 0.5f) + 0.5f) * ampModAmount + 1 - ampModAmount);
-		buffer[i] += osc1buf[i] * _vcaFilter.processSample(amplitude * mVolume.processSample(vol));
+	const SharedRamps::Ramp &ampModRamp = ramps.mAmpModAmount, &velSensRamp = ramps.mAmpVelSens;
+	if (ampModRamp.settled && velSensRamp.settled) {
+		const float ampModAmount = ampModRamp.param.getRawValue();
+		const float gain = BLEND(1.f, mKeyVelocity, velSensRamp.param.getRawValue());
+		kAmplitudeScalers[ampModAmount != 0.f](ampenvbuf, lfo1buf, numSamples, gain, ampModAmount * 0.5f, 1 - ampModAmount * 0.5f);
+	} else {
+		for (int i=0; i<numSamples; i++) {
+			float ampModAmount = ampModRamp.values[i];
+			ampenvbuf[i] *= BLEND(1.f, mKeyVelocity, velSensRamp.values[i]) *
+				( ((lfo1buf[i] * 0.5f) + 0.5f) * ampModAmount + 1 - ampModAmount);
+		}
+	}
+	const SharedRamps::Ramp &volumeRamp = ramps.mVolume;
+	if (volumeRamp.settled) {
+		const float vol = volumeRamp.param.getRawValue();
+		for (int i=0; i<numSamples; i++) {
+			buffer[i] += osc1buf[i] * _vcaFilter.processSample(ampenvbuf[i] * vol);
+		}
+	} else {
+		for (int i=0; i<numSamples; i++) {
+			buffer[i] += osc1buf[i] * _vcaFilter.processSample(ampenvbuf[i] * volumeRamp.values[i]);
+		}
 	}
 }
 
@@ -217,30 +460,45 @@ void
 VoiceBoard::SetSampleRate	(int rate)
 {
 	mSampleRate = rate;
-	lfo1.SetSampleRate (rate);
+	lfo1.SetSampleRate (mSampleRate / mControlPeriod);
 	osc1.SetSampleRate (rate);
 	osc2.SetSampleRate (rate);
 	filter.SetSampleRate (rate);
-	mFilterADSR.SetSampleRate(rate);
+	mFilterADSR.SetSampleRate(mSampleRate / mControlPeriod);
 	mAmpADSR.SetSampleRate(rate);
 	_vcaFilter.setCoefficients(rate, kVCALowPassFreq, IIRFilterFirstOrder::Mode::kLowPass);
 }
 
+void
+VoiceBoard::setControlPeriod	(int samples)
+{
+	assert(1 <= samples && samples <= kMaxControlPeriod);
+	mControlPeriod = samples;
+	mControlLeft = 0;
+	lfo1.SetSampleRate (mSampleRate / mControlPeriod);
+	mFilterADSR.SetSampleRate(mSampleRate / mControlPeriod);
+}
+
 bool 
 VoiceBoard::isSilent()
 {
 	return mAmpADSR.getState() == 0 && _vcaFilter._z < 0.0000001;
 }
 
+float
+VoiceBoard::getCostEstimate() const
+{
+	float cost = 3; // LFO, oscillators, envelopes and amplifier
+	if (mFilterType != SynthFilter::Type::kBypass)
+		cost += (mFilterSlope == SynthFilter::Slope::k24) ? 2 : 1;
+	if (mOsc2Sync)
+		cost += 1;
+	return cost;
+}
+
 void 
-VoiceBoard::triggerOn(bool reset)
+VoiceBoard::triggerOn()
 {
-	if (reset) {
-		mOscMix.reset();
-		mRingModAmt.reset();
-		mAmpModAmount.reset();
-		mAmpVelSens.reset();
-	}
 	mAmpADSR.triggerOn();
 	mFilterADSR.triggerOn();
 }
@@ -261,6 +519,9 @@ VoiceBoard::reset()
 	osc2.reset();
 	filter.reset();
 	lfo1.reset();
+	mControlLeft = 0;
+	mLFORamp = ControlRamp();
+	mFilterEnvRamp = ControlRamp();
 }
 
 void
@@ -26,6 +26,7 @@
 #include "ADSR.h"
 #include "Oscillator.h"
 #include "LowPassFilter.h"
+#include "PatchParameters.h"
 #include "Synth--.h"
 
 /**
@@ -39,10 +40,14 @@ class VoiceBoard
 {
 public:
 
-	static constexpr int kMaxProcessBufferSize = 64;
+	/**
+	 * The largest block the voice can render in one call. The block size
+	 * actually used is chosen per instance by VoiceAllocationUnit.
+	 */
+	static constexpr int kMaxProcessBufferSize = 256;
 
 	bool	isSilent		();
-	void	triggerOn		(bool reset);
+	void	triggerOn		();
 	void	triggerOff		();
 	void	setVelocity		(float velocity);
 	
@@ -54,13 +59,135 @@ public:
 
 	void	UpdateParameter		(Param, float);
 
-	void	ProcessSamplesMix	(float *buffer, int numSamples, float vol);
+	/**
+	 * Applies the parameters that have changed since the last call.
+	 */
+	void	syncParameters		(const PatchParameters &);
+
+	static constexpr int kMaxBankSize = SynthFilter::kMaxLanes;
+
+	/**
+	 * Scratch buffers used while rendering. Nothing in them outlives a call
+	 * to ProcessSamplesMix, so a single workspace serves every voice
+	 * rendered on a thread, keeping VoiceBoard itself small. The buffers
+	 * that have to survive until the bank's filters have run are kept per
+	 * lane.
+	 */
+	struct Workspace {
+		float osc_1[kMaxBankSize][kMaxProcessBufferSize];
+		float lfo_osc_1[kMaxBankSize][kMaxProcessBufferSize];
+		float filter_cutoff[kMaxBankSize][kMaxProcessBufferSize];
+		float osc_2[kMaxProcessBufferSize];
+		float filter_env[kMaxProcessBufferSize];
+		float amp_env[kMaxProcessBufferSize];
+		float control[kMaxProcessBufferSize];
+	};
+
+	/**
+	 * The patch parameters that glide to new values instead of jumping,
+	 * including the master volume. They are the same for every voice, so
+	 * the VoiceAllocationUnit keeps one set and smooths them once per block,
+	 * and the voices read the resulting ramps.
+	 *
+	 * In LFOModeGlobal the LFO is kept here too, running freely so that
+	 * every voice follows the same phase, in place of the voices' own LFOs.
+	 */
+	class SharedRamps
+	{
+	public:
+		void	UpdateParameter	(Param, float);
+
+		void	SetSampleRate	(int rate) { mLFO.SetSampleRate(rate); }
+		void	setRandomSeed	(uint32_t seed) { mLFO.setRandomSeed(seed); }
+
+		/** Advances every parameter by numSamples; call once per block, before the voices */
+		void	process			(int numSamples);
+
+		/** Jumps every parameter to its latest value, for when no voice is there to hear a glide */
+		void	reset			();
+
+	private:
+		friend class VoiceBoard;
+
+		struct Ramp {
+			explicit Ramp(float value): param(value) {}
+			void	process(int numSamples);
+
+			SmoothedParam	param;
+			bool			settled = true; // if every value this block is param.getRawValue()
+			float			values[kMaxProcessBufferSize];
+		};
+
+		Ramp	mOscMix{0.f};
+		Ramp	mRingModAmt{0.f};
+		Ramp	mAmpModAmount{0.f};
+		Ramp	mAmpVelSens{1.f};
+		Ramp	mVolume{1.f};
+
+		Oscillator	mLFO;
+		float		mLFOFreq = 0;
+		float		mLFOPulseWidth = 0;
+		bool		mGlobalLFO = false;
+		float		mLFOValues[kMaxProcessBufferSize];
+	};
+
+	void	ProcessSamplesMix	(float *buffer, int numSamples, const SharedRamps &, Workspace &);
+
+	/**
+	 * Renders up to kMaxBankSize voices together. The oscillators and
+	 * envelopes run per voice, but the filters run as one bank so that
+	 * their recurrences are computed side by side.
+	 */
+	static void	ProcessSamplesMix	(VoiceBoard *voices[], int count, float *buffer, int numSamples, const SharedRamps &, Workspace &);
 
 	void	SetSampleRate		(int);
 
+	/** Applies to the audio oscillators only, the LFO is unaffected */
+	void	setBandLimitedOscillators	(bool enabled) { osc1.setBandLimited(enabled); osc2.setBandLimited(enabled); }
+
+	/**
+	 * Moves the filter cutoff with the envelope and LFO every sample,
+	 * instead of once per block.
+	 */
+	void	setSVFFilter		(bool enabled) { mSVFFilter = enabled; }
+
+	static constexpr int kMaxControlPeriod = 64;
+
+	/**
+	 * Runs the LFO and filter envelope once every samples (1 to
+	 * kMaxControlPeriod), ramping linearly between their values where they
+	 * feed the amplifier and per-sample filter cutoff. The ramps trail the
+	 * control signals by one period.
+	 */
+	void	setControlPeriod	(int samples);
+
+	/** Gives each of the voice's oscillators its own seed derived from this one */
+	void	setRandomSeed		(uint32_t seed) { lfo1.setRandomSeed(seed * 3); osc1.setRandomSeed(seed * 3 + 1); osc2.setRandomSeed(seed * 3 + 2); }
+
+	/**
+	 * Rough relative cost of rendering this voice, used to balance voices
+	 * across threads.
+	 */
+	float	getCostEstimate		() const;
+
 private:
 
-	ParamSmoother	mVolume{0.f};
+	// @return false if the filter is bypassed. In SVF mode the cutoff is
+	// written to the workspace instead of the coefficients being calculated.
+	bool	processOscillators	(Workspace &, int lane, int numSamples, const SharedRamps &, SynthFilter::Coefficients &);
+	void	processAmplifier	(Workspace &, int lane, float *buffer, int numSamples, const SharedRamps &);
+
+	struct ControlRamp {
+		float target = 0;
+		float step = 0;
+	};
+
+	// The number of control values due in the next numSamples
+	int		controlPoints		(int numSamples) const;
+	// Fills buffer with numSamples of ramp, taking its next targets from points
+	void	rampControl			(const float *points, float *buffer, int numSamples, ControlRamp &) const;
+
+	uint64_t		mParametersVersion = 0;
 
 	Lerper			mFrequency;
 	bool			mFrequencyDirty = false;
@@ -69,6 +196,8 @@ private:
 	float			mFrequencyTime = 0;
 
 	float			mSampleRate = 44100;
+	int				mControlPeriod = 1;
+	int				mControlLeft = 0; // samples until the next control value
 	float			mKeyVelocity = 1;
 	float			mPitchBend = 1;
 	
@@ -76,6 +205,7 @@ private:
 	Oscillator 		lfo1;
 	float			mLFO1Freq = 0;
 	float			mLFOPulseWidth = 0;
+	ControlRamp		mLFORamp;
 	
 	// oscillator section
 	Oscillator 		osc1, osc2;
@@ -83,8 +213,6 @@ private:
 	int				mFreqModDestination = 0;
 	float			mOsc1PulseWidth = 0;
 	float			mOsc2PulseWidth = 0;
-	SmoothedParam	mOscMix{0.f};
-	SmoothedParam	mRingModAmt{0.f};
 	float			mOsc2Octave = 1;
 	float			mOsc2Detune = 1;
 	float			mOsc2Pitch = 0;
@@ -100,21 +228,13 @@ private:
 	SynthFilter 	filter;
 	SynthFilter::Type mFilterType;
 	SynthFilter::Slope mFilterSlope;
+	bool			mSVFFilter = false;
 	ADSR 			mFilterADSR;
+	ControlRamp		mFilterEnvRamp;
 	
 	// amp section
 	IIRFilterFirstOrder _vcaFilter;
-	SmoothedParam	mAmpModAmount{-1.f};
-	SmoothedParam	mAmpVelSens{1.f};
 	ADSR 			mAmpADSR;
-
-	struct {
-		float osc_1[kMaxProcessBufferSize];
-		float osc_2[kMaxProcessBufferSize];
-		float lfo_osc_1[kMaxProcessBufferSize];
-		float filter_env[kMaxProcessBufferSize];
-		float amp_env[kMaxProcessBufferSize];
-	} mProcessBuffers;
 };
 
 #endif
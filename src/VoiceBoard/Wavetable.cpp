@@ -0,0 +1,114 @@
+/*
+ *  Wavetable.cpp
+ *
+ *  Copyright (c) 2022 Nick Dowell
+ *
+ *  This file is part of amsynth.
+ *
+ *  amsynth is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  amsynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with amsynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Wavetable.h"
+
+#include <cmath>
+
+
+static double sineAmplitude(int harmonic)
+{
+	return harmonic == 1 ? 1.0 : 0.0;
+}
+
+static double sawAmplitude(int harmonic)
+{
+	return -2.0 / (M_PI * harmonic);
+}
+
+static double parabolaAmplitude(int harmonic)
+{
+	return 1.0 / (M_PI * M_PI * harmonic * harmonic);
+}
+
+const Wavetable &
+Wavetable::sine()
+{
+	static const Wavetable table(1, Series::kSine, sineAmplitude);
+	return table;
+}
+
+const Wavetable &
+Wavetable::saw()
+{
+	static const Wavetable table(kLevels, Series::kSine, sawAmplitude);
+	return table;
+}
+
+const Wavetable &
+Wavetable::parabola()
+{
+	static const Wavetable table(kLevels, Series::kCosine, parabolaAmplitude);
+	return table;
+}
+
+void
+Wavetable::prepare()
+{
+	sine();
+	saw();
+	parabola();
+}
+
+int
+Wavetable::levelForIncrement(float increment)
+{
+	// level n is safe while (kMaxHarmonics >> n) * increment <= 0.5
+	int level = 0;
+	float highest = kMaxHarmonics * increment;
+	while (highest > 0.5f && level < kLevels - 1) {
+		highest *= 0.5f;
+		level++;
+	}
+	return level;
+}
+
+Wavetable::Wavetable(int levels, Series series, double (*amplitude)(int harmonic))
+:	mLevels(levels)
+,	mData(levels * (kSize + 1))
+{
+	// sin(2 pi k i / kSize) repeats every kSize samples, so one period
+	// of a sine serves for every harmonic
+	std::vector<double> sine(kSize);
+	for (int i = 0; i < kSize; i++)
+		sine[i] = sin(2.0 * M_PI * i / kSize);
+	const int phaseOffset = series == Series::kCosine ? kSize / 4 : 0;
+
+	// The levels are nested partial sums of the same series, so they are
+	// filled in as the sum passes each level's number of harmonics
+	std::vector<double> sum(kSize, 0.0);
+	const int harmonics = kMaxHarmonics >> (kLevels - levels);
+	for (int k = 1; k <= harmonics; k++) {
+		const double a = amplitude(k);
+		if (a != 0.0) {
+			for (int i = 0; i < kSize; i++)
+				sum[i] += a * sine[(k * i + phaseOffset) % kSize];
+		}
+		for (int n = 0; n < levels; n++) {
+			if ((harmonics >> n) == k) {
+				float *table = &mData[n * (kSize + 1)];
+				for (int i = 0; i < kSize; i++)
+					table[i] = (float) sum[i];
+				table[kSize] = table[0];
+			}
+		}
+	}
+}
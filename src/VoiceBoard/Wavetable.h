@@ -0,0 +1,83 @@
+/*
+ *  Wavetable.h
+ *
+ *  Copyright (c) 2022 Nick Dowell
+ *
+ *  This file is part of amsynth.
+ *
+ *  amsynth is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  amsynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with amsynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _WAVETABLE_H
+#define _WAVETABLE_H
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * A band-limited single cycle waveform, stored once per octave so that an
+ * oscillator can always pick a table with no harmonics above Nyquist.
+ *
+ * Level n holds the first (kMaxHarmonics >> n) harmonics. The tables are
+ * built on first use and shared read-only by every oscillator; call
+ * prepare() from a non-realtime thread before the audio thread needs them.
+ */
+class Wavetable
+{
+public:
+
+	static constexpr int kSize = 4096;
+	static constexpr int kLevels = 11;
+	static constexpr int kMaxHarmonics = 1 << (kLevels - 1);
+
+	/** sin(2 pi t) */
+	static const Wavetable & sine();
+
+	/** The rising sawtooth 2t - 1 */
+	static const Wavetable & saw();
+
+	/** The integral of the sawtooth, t^2 - t + 1/6, used to build triangles */
+	static const Wavetable & parabola();
+
+	static void prepare();
+
+	/**
+	 * @param increment oscillator frequency divided by the sample rate
+	 * @return the most detailed level that doesn't alias at that frequency
+	 */
+	static int levelForIncrement(float increment);
+
+	/** @return kSize + 1 samples, the last repeating the first */
+	const float * level(int n) const { return &mData[std::min(n, mLevels - 1) * (kSize + 1)]; }
+
+	/** Linearly interpolated lookup, with phase in cycles [0, 1) */
+	static inline float lookup(const float *table, float phase)
+	{
+		const float index = phase * kSize;
+		const int i = (int) index;
+		const float frac = index - (float) i;
+		return table[i] + frac * (table[i + 1] - table[i]);
+	}
+
+private:
+
+	enum class Series { kSine, kCosine };
+
+	Wavetable(int levels, Series, double (*amplitude)(int harmonic));
+
+	int mLevels;
+	std::vector<float> mData;
+};
+
+#endif
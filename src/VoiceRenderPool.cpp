@@ -0,0 +1,228 @@
+/*
+ *  VoiceRenderPool.cpp
+ *
+ *  Copyright (c) 2022 Nick Dowell
+ *
+ *  This file is part of amsynth.
+ *
+ *  amsynth is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  amsynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with amsynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "VoiceRenderPool.h"
+
+#include "DenormalGuard.h"
+
+#if HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <assert.h>
+#include <cstring>
+
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+constexpr int VoiceRenderPool::kMaxThreads;
+
+static inline uint32_t packRange(uint32_t front, uint32_t back) { return front | (back << 16); }
+static inline uint32_t rangeFront(uint32_t range) { return range & 0xffff; }
+static inline uint32_t rangeBack(uint32_t range) { return range >> 16; }
+
+
+VoiceRenderPool::VoiceRenderPool(int threads)
+:	mThreadCount(std::min(std::max(threads, 1), kMaxThreads))
+,	mWorkspaces(mThreadCount)
+{
+	for (int i = 1; i < mThreadCount; i++)
+		mThreads.emplace_back(&VoiceRenderPool::workerMain, this, i);
+}
+
+VoiceRenderPool::~VoiceRenderPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mQuit = true;
+	}
+	mWakeup.notify_all();
+	for (auto &thread : mThreads)
+		thread.join();
+}
+
+void
+VoiceRenderPool::propagatePriority()
+{
+	// The workers must not be preempted by anything the audio thread isn't,
+	// so they take on its scheduling class the first time we're called from
+	// it. This is best effort; it fails without realtime privileges.
+#ifndef _WIN32
+	int policy;
+	sched_param param;
+	if (pthread_getschedparam(pthread_self(), &policy, &param) == 0 && policy != SCHED_OTHER) {
+		for (auto &thread : mThreads)
+			pthread_setschedparam(thread.native_handle(), policy, &param);
+	}
+#endif
+	mPriorityPropagated = true;
+}
+
+void
+VoiceRenderPool::workerMain(int index)
+{
+	DenormalGuard denormalGuard; // as for the audio thread, see Synthesizer::process
+	unsigned generation = 0;
+	while (true) {
+		{
+			std::unique_lock<std::mutex> lock(mMutex);
+			mWakeup.wait(lock, [&] { return mQuit || mGeneration.load() != generation; });
+			if (mQuit)
+				return;
+			generation = mGeneration.load();
+		}
+		// A worker that wakes up late must not touch a block that process()
+		// has already finished with, hence the check after announcing itself.
+		mBusy.fetch_add(1);
+		if (mOpen.load())
+			runJobs(index);
+		mBusy.fetch_sub(1);
+	}
+}
+
+void
+VoiceRenderPool::runJob(int thread, int index)
+{
+	Job &job = mJobs[index];
+	VoiceBoard::Workspace &workspace = mWorkspaces[thread];
+#ifdef AMSYNTH_COUNT_DENORMALS
+	if (thread != 0)
+		DenormalGuard::clearUnderflow();
+#endif
+	memset(job.buffer, 0, mNumSamples * sizeof(float));
+	if (job.count == 1) {
+		job.voices[0]->ProcessSamplesMix(job.buffer, mNumSamples, *mRamps, workspace);
+	} else {
+		VoiceBoard::ProcessSamplesMix(job.voices, job.count, job.buffer, mNumSamples, *mRamps, workspace);
+	}
+#ifdef AMSYNTH_COUNT_DENORMALS
+	// The caller's own flag is checked by the caller
+	if (thread != 0 && DenormalGuard::underflowed())
+		mUnderflowed.store(true, std::memory_order_relaxed);
+#endif
+	mJobsDone.fetch_add(1, std::memory_order_release);
+}
+
+void
+VoiceRenderPool::runJobs(int index)
+{
+	// Our own queue first, from the most expensive job down...
+	std::atomic<uint32_t> &own = mQueues[index].range;
+	uint32_t range = own.load(std::memory_order_relaxed);
+	while (rangeFront(range) < rangeBack(range)) {
+		if (own.compare_exchange_weak(range, packRange(rangeFront(range) + 1, rangeBack(range)), std::memory_order_relaxed))
+			runJob(index, mOrder[rangeFront(range)]);
+	}
+
+	// ...then the cheapest remaining jobs of the other threads
+	for (int i = 1; i < mThreadCount; i++) {
+		std::atomic<uint32_t> &other = mQueues[(index + i) % mThreadCount].range;
+		range = other.load(std::memory_order_relaxed);
+		while (rangeFront(range) < rangeBack(range)) {
+			if (other.compare_exchange_weak(range, packRange(rangeFront(range), rangeBack(range) - 1), std::memory_order_relaxed))
+				runJob(index, mOrder[rangeBack(range) - 1]);
+		}
+	}
+}
+
+void
+VoiceRenderPool::process(VoiceBoard *voices[], int count, float *buffer, int numSamples, const VoiceBoard::SharedRamps &ramps)
+{
+	assert(count <= kMaxVoices);
+	assert(numSamples <= VoiceBoard::kMaxProcessBufferSize);
+
+	if (!mPriorityPropagated)
+		propagatePriority();
+
+	mNumSamples = numSamples;
+	mRamps = &ramps;
+	mJobCount = 0;
+	for (int i = 0; i < count; i += VoiceBoard::kMaxBankSize) {
+		Job &job = mJobs[mJobCount];
+		job.count = std::min(count - i, VoiceBoard::kMaxBankSize);
+		job.cost = 0;
+		for (int j = 0; j < job.count; j++) {
+			job.voices[j] = voices[i + j];
+			job.cost += voices[i + j]->getCostEstimate();
+		}
+		mOrder[mJobCount] = mJobCount;
+		mJobCount++;
+	}
+
+	// Waking the workers costs more than rendering a single bank
+	if (mJobCount == 1 || mThreadCount == 1) {
+		for (int i = 0; i < mJobCount; i++)
+			runJob(0, i);
+	} else {
+		// Deal the jobs out, most expensive first, each to the thread with
+		// the least work so far (longest processing time first scheduling)
+		std::stable_sort(mOrder, mOrder + mJobCount, [this](int a, int b) { return mJobs[a].cost > mJobs[b].cost; });
+		int owner[kMaxJobs], owned[kMaxThreads] = {0};
+		for (int t = 0; t < mThreadCount; t++)
+			mQueues[t].cost = 0;
+		for (int i = 0; i < mJobCount; i++) {
+			int t = 0;
+			for (int u = 1; u < mThreadCount; u++)
+				if (mQueues[u].cost < mQueues[t].cost)
+					t = u;
+			mQueues[t].cost += mJobs[mOrder[i]].cost;
+			owner[i] = t;
+			owned[t]++;
+		}
+		int sorted[kMaxJobs], next[kMaxThreads];
+		for (int t = 0, begin = 0; t < mThreadCount; begin += owned[t], t++) {
+			next[t] = begin;
+			mQueues[t].range.store(packRange(begin, begin + owned[t]), std::memory_order_relaxed);
+		}
+		for (int i = 0; i < mJobCount; i++)
+			sorted[next[owner[i]]++] = mOrder[i];
+		memcpy(mOrder, sorted, mJobCount * sizeof(int));
+
+		mJobsDone.store(0);
+		mOpen.store(true);
+		{
+			// Never block the audio thread; if a worker holds the lock it
+			// may miss this wakeup and sit the block out, which is harmless
+			// as the remaining threads steal its jobs.
+			std::unique_lock<std::mutex> lock(mMutex, std::try_to_lock);
+			mGeneration.fetch_add(1);
+		}
+		mWakeup.notify_all();
+
+		runJobs(0);
+
+		while (mJobsDone.load(std::memory_order_acquire) < mJobCount)
+			std::this_thread::yield();
+		mOpen.store(false);
+		while (mBusy.load() != 0)
+			std::this_thread::yield();
+	}
+
+	for (int i = 0; i < mJobCount; i++) {
+		const float *jobBuffer = mJobs[i].buffer;
+		for (int j = 0; j < numSamples; j++)
+			buffer[j] += jobBuffer[j];
+	}
+}
@@ -0,0 +1,120 @@
+/*
+ *  VoiceRenderPool.h
+ *
+ *  Copyright (c) 2022 Nick Dowell
+ *
+ *  This file is part of amsynth.
+ *
+ *  amsynth is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  amsynth is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with amsynth.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _VOICERENDERPOOL_H
+#define _VOICERENDERPOOL_H
+
+#include "VoiceBoard/VoiceBoard.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Renders the active voices on a fixed pool of worker threads, created up
+ * front so that nothing is allocated or spawned on the audio thread.
+ *
+ * The voices are grouped into banks (see VoiceBoard::ProcessSamplesMix),
+ * and the banks are dealt out to the threads by their estimated cost.
+ * Each thread then works through its own queue and steals from the others
+ * when it runs dry, so a thread holding an expensive bank doesn't hold up
+ * the block. The calling thread takes part as thread 0.
+ *
+ * Each bank is mixed into its own scratch buffer by whichever thread
+ * renders it, and the buffers are summed in a fixed order afterwards, so
+ * the output doesn't depend on how the work was scheduled.
+ */
+class VoiceRenderPool
+{
+public:
+
+	static constexpr int kMaxThreads = 16;
+	static constexpr int kMaxVoices = 128;
+	static constexpr int kMaxJobs = (kMaxVoices + VoiceBoard::kMaxBankSize - 1) / VoiceBoard::kMaxBankSize;
+
+	/** @param threads total number of rendering threads, including the caller */
+	explicit	VoiceRenderPool		(int threads);
+				~VoiceRenderPool	();
+
+	int		getThreadCount		() const { return mThreadCount; }
+
+	/**
+	 * Renders count voices, adding the result to buffer. Called from the
+	 * audio thread only.
+	 */
+	void	process		(VoiceBoard *voices[], int count, float *buffer, int numSamples, const VoiceBoard::SharedRamps &);
+
+	/**
+	 * True if a worker thread has flushed denormals since the last call.
+	 * Only tracked in builds configured with AMSYNTH_COUNT_DENORMALS.
+	 */
+	bool	takeUnderflow	() { return mUnderflowed.exchange(false, std::memory_order_relaxed); }
+
+private:
+
+	struct Job {
+		float		buffer[VoiceBoard::kMaxProcessBufferSize];
+		VoiceBoard	*voices[VoiceBoard::kMaxBankSize];
+		int			count;
+		float		cost;
+	};
+
+	// Each thread's queue is a range of mOrder, sorted from the most to the
+	// least expensive job, packed into one word as (front | back << 16).
+	// The owner takes jobs from the front and thieves from the back, each
+	// with a single compare-and-swap.
+	struct Queue {
+		std::atomic<uint32_t>	range{0};
+		float					cost = 0;
+		char					padding[56]; // keep queues on separate cache lines
+	};
+
+	void	workerMain		(int index);
+	void	runJobs			(int index);
+	void	runJob			(int thread, int job);
+	void	propagatePriority	();
+
+	const int			mThreadCount;
+	std::vector<std::thread>	mThreads;
+	std::vector<VoiceBoard::Workspace>	mWorkspaces;
+
+	Job					mJobs[kMaxJobs];
+	int					mOrder[kMaxJobs];
+	int					mJobCount = 0;
+	Queue				mQueues[kMaxThreads];
+	int					mNumSamples = 0;
+	const VoiceBoard::SharedRamps	*mRamps = nullptr;
+
+	std::atomic<bool>		mOpen{false};
+	std::atomic<int>		mBusy{0};
+	std::atomic<int>		mJobsDone{0};
+	std::atomic<unsigned>	mGeneration{0};
+	std::atomic<bool>		mUnderflowed{false};
+	bool				mQuit = false;
+	bool				mPriorityPropagated = false;
+	std::mutex			mMutex;
+	std::condition_variable	mWakeup;
+};
+
+#endif
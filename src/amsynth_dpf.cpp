@@ -339,6 +339,7 @@ void AmsynthPlugin::sampleRateChanged(double newSampleRate)
 Synthesizer_DPF::Synthesizer_DPF()
     : Synthesizer()
 {
+    fMidiEvents.reserve(1024);
 }
 
 String Synthesizer_DPF::getParameterDisplay(Param parameter) const
@@ -351,40 +352,15 @@ void Synthesizer_DPF::process(unsigned int nframes,
     std::vector<amsynth_midi_cc_t>& midi_out,
     float* audio_l, float* audio_r, unsigned audio_stride)
 {
-    if (_sampleRate < 0) {
-        assert(nullptr == "sample rate has not been set");
-        return;
-    }
-    if (getIfNeedsResetAllVoices()) {
-        setIfNeedsResetAllVoices(false);
-        _voiceAllocationUnit->resetAllVoices();
-    }
-    uint32_t event_index = 0;
-    unsigned frames_left_in_buffer = nframes, frame_index = 0;
-    while (frames_left_in_buffer) {
-        while (event_index < midi_in_event_count && midi_in[event_index].frame <= frame_index) {
-            _midiController->HandleMidiData(midi_in[event_index].data, midi_in[event_index].size);
-            ++event_index;
-        }
-
-        unsigned block_size_frames = std::min(frames_left_in_buffer, (unsigned)VoiceBoard::kMaxProcessBufferSize);
-        if (event_index < midi_in_event_count && midi_in[event_index].frame > frame_index) {
-            unsigned frames_until_next_event = midi_in[event_index].frame - frame_index;
-            block_size_frames = std::min(block_size_frames, frames_until_next_event);
-        }
-
-        _voiceAllocationUnit->Process(audio_l + (frame_index * audio_stride),
-            audio_r + (frame_index * audio_stride),
-            block_size_frames, audio_stride);
-
-        frame_index += block_size_frames;
-        frames_left_in_buffer -= block_size_frames;
-    }
-    while (event_index < midi_in_event_count) {
-        _midiController->HandleMidiData(midi_in[event_index].data, midi_in[event_index].size);
-        ++event_index;
+    // Rendered by Synthesizer::process, so that the plugin shares its
+    // block loop, denormal guard and idle fast path
+    fMidiEvents.clear();
+    for (uint32_t i = 0; i < midi_in_event_count; i++) {
+        const MidiEvent &event = midi_in[i];
+        const uint8_t *data = event.size > MidiEvent::kDataSize ? event.dataExt : event.data;
+        fMidiEvents.push_back({ event.frame, event.size, const_cast<unsigned char *>(data) });
     }
-    _midiController->generateMidiOutput(midi_out);
+    Synthesizer::process(nframes, fMidiEvents, midi_out, audio_l, audio_r, audio_stride);
 }
 
 // --------------------------------------------------------------------------------------------------------------------
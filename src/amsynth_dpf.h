@@ -44,6 +44,11 @@ public:
                             const MidiEvent* &midi_in, uint32_t midi_in_event_count,
                             std::vector<amsynth_midi_cc_t> &midi_out,
                             float *audio_l, float *audio_r, unsigned audio_stride = 1);
+
+private:
+    // Reused from one call to the next, so that converting the events
+    // doesn't allocate on the audio thread
+    std::vector<amsynth_midi_event_t> fMidiEvents;
 };
 
 class AmsynthPlugin : public Plugin
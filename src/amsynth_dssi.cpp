@@ -232,12 +232,7 @@ static void run_synth (LADSPA_Handle instance, unsigned long sample_count, snd_s
 		}
 	}
 
-	for (unsigned i = (Param)0; i < kAmsynthParameterCount; i++) {
-		const LADSPA_Data host_value = *(a->params[i]);
-		if (a->synth->getParameterValue((Param)i) != host_value) {
-			a->synth->setParameterValue((Param)i, host_value);
-		}
-	}
+	a->synth->setParameterValues(a->params);
 
 	std::vector<amsynth_midi_cc_t> midi_out;
 	a->synth->process(sample_count, midi_events, midi_out, a->out_l, a->out_r);
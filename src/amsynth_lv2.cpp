@@ -170,14 +170,7 @@ lv2_run(LV2_Handle instance, uint32_t sample_count)
 		}
 	}
 
-	for (unsigned i=0; i<kAmsynthParameterCount; i++) {
-		const float *host_value = a->param_ports[i];
-		if (host_value != nullptr) {
-			if (a->synth.getParameterValue((Param)i) != *host_value) {
-				a->synth.setParameterValue((Param)i, *host_value);
-			}
-		}
-	}
+	a->synth.setParameterValues(a->param_ports);
 
 	std::vector<amsynth_midi_cc_t> midi_out;
 	a->synth.process(sample_count, midi_events, midi_out, a->out_l, a->out_r);
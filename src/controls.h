@@ -85,6 +85,7 @@ typedef enum {
 	kAmsynthParameter_AmpVelocityAmount        = 39,
 	
 	kAmsynthParameter_PortamentoMode           = 40,
+	kAmsynthParameter_LFOMode                  = 41,
 
 	kAmsynthParameterCount
 } Param;
@@ -100,6 +101,18 @@ typedef enum {
 	PortamentoModeLegato
 } PortamentoMode;
 
+typedef enum {
+	LFOModePerVoice,
+	LFOModeGlobal
+} LFOMode;
+
+/** Which of the held notes a mono or legato voice plays */
+typedef enum {
+	NotePriorityLast,
+	NotePriorityLow,
+	NotePriorityHigh,
+} NotePriority;
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -244,6 +244,7 @@ int main( int argc, char *argv[] )
 	static struct option longopts[] = {
 		{ "jack_autoconnect", optional_argument, nullptr, 0 },
 		{ "force-device-scale-factor", required_argument, nullptr, 0 },
+		{ "render-threads", required_argument, nullptr, 0 },
 		{ nullptr }
 	};
 	
@@ -273,6 +274,8 @@ int main( int argc, char *argv[] )
 				     << _("	-m <string> set the MIDI driver to use [alsa/oss/auto(default)]") << endl
 				     << _("	-c <int>    set the MIDI channel to respond to (default=all)") << endl
 				     << _("	-p <int>    set the polyphony (maximum active voices)") << endl
+				     << _("	--render-threads <int>") << endl
+				     << _("	            number of threads used to render voices (Default: 1)") << endl
 				     << endl
 				     << _("	-n <name>   specify the JACK client name to use") << endl
 				     << _("	--jack_autoconnect[=<true|false>]") << endl
@@ -329,6 +332,9 @@ int main( int argc, char *argv[] )
 				if (strcmp(longopts[longindex].name, "force-device-scale-factor") == 0) {
 					gui_scale_factor = atoi(optarg);
 				}
+				if (strcmp(longopts[longindex].name, "render-threads") == 0) {
+					config.render_threads = atoi(optarg);
+				}
 				break;
 			default:
 				break;
@@ -356,6 +362,16 @@ int main( int argc, char *argv[] )
 	s_synthesizer = new Synthesizer();
 	s_synthesizer->setSampleRate(config.sample_rate);
 	s_synthesizer->setMaxNumVoices(config.polyphony);
+	s_synthesizer->setBlockSize(config.block_size);
+	s_synthesizer->setRenderThreads(config.render_threads);
+	s_synthesizer->setBandLimitedOscillators(config.bandlimited_oscillators);
+	s_synthesizer->setSVFFilter(config.svf_filter);
+	s_synthesizer->setControlPeriod(config.control_period);
+	s_synthesizer->setRandomSeed(config.random_seed);
+	s_synthesizer->setDistortionOversampling(config.distortion_oversampling);
+	s_synthesizer->setLimiterLookahead(config.limiter_lookahead_ms / 1000.f);
+	s_synthesizer->setNotePriority(config.note_priority == "low" ? NotePriorityLow :
+	                               config.note_priority == "high" ? NotePriorityHigh : NotePriorityLast);
 	s_synthesizer->setMidiChannel(config.midi_channel);
 	s_synthesizer->setPitchBendRangeSemitones(config.pitch_bend_range);
 	if (config.current_tuning_file != "default") {
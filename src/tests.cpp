@@ -20,17 +20,30 @@
  */
 
 #include "controls.h"
+#include "DenormalGuard.h"
+#include "Effects/Distortion.h"
+#include "Effects/SoftLimiter.h"
 #include "midi.h"
 #include "MidiController.h"
+#include "Preset.h"
 #include "Synthesizer.h"
 #include "VoiceAllocationUnit.h"
+#include "VoiceBoard/ADSR.h"
+#include "VoiceBoard/CPUFeatures.h"
+#include "VoiceBoard/FastMath.h"
 #include "VoiceBoard/Oscillator.h"
 #include "VoiceBoard/LowPassFilter.h"
 #include "VoiceBoard/VoiceBoard.h"
+#include "VoiceBoard/Wavetable.h"
 
+#include <freeverb/revmodel.hpp>
+
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstdio>
 #include <iostream>
+#include <thread>
 
 #define TEST(name) static void name()
 
@@ -162,6 +175,341 @@ TEST(testMidiAllNotesOff) {
     delete synth;
 }
 
+TEST(testVoiceStealing) {
+    VoiceAllocationUnit vau;
+    vau.SetSampleRate(44100);
+    vau.setKeyboardMode(KeyboardModePoly);
+    vau.SetMaxVoices(2);
+
+    vau.HandleMidiNoteOn(60, 1.f);
+    vau.HandleMidiNoteOn(62, 1.f);
+    vau.HandleMidiNoteOn(64, 1.f); // steals the oldest voice
+    assert(!vau.isNoteActive(60) && vau.isNoteActive(62) && vau.isNoteActive(64));
+
+    vau.HandleMidiNoteOff(64, 0.f);
+    vau.HandleMidiNoteOn(65, 1.f); // steals the voice in its release phase
+    assert(vau.isNoteActive(62) && !vau.isNoteActive(64) && vau.isNoteActive(65));
+
+    vau.HandleMidiSustainPedal(127);
+    vau.HandleMidiNoteOff(62, 0.f);
+    vau.HandleMidiNoteOn(67, 1.f); // sustained notes are stolen before held notes
+    assert(!vau.isNoteActive(62) && vau.isNoteActive(65) && vau.isNoteActive(67));
+    vau.HandleMidiSustainPedal(0);
+}
+
+TEST(testRepeatedNoteKeepsTail) {
+    VoiceAllocationUnit vau;
+    vau.SetSampleRate(44100);
+    vau.setKeyboardMode(KeyboardModePoly);
+    vau.SetMaxVoices(4);
+    assert(vau._voices.size() == 4);
+
+    vau.HandleMidiNoteOn(60, 1.f);
+    vau.HandleMidiNoteOn(60, 1.f); // the first voice is released, not cut
+    assert(vau._activeCount == 2);
+    vau.HandleMidiNoteOff(60, 0.f);
+    assert(vau._activeCount == 2 && vau.isNoteActive(60));
+}
+
+TEST(testMaxVoicesWhileProcessing) {
+    Synthesizer synth;
+    synth.setSampleRate(44100);
+    std::vector<amsynth_midi_event_t> midi_in;
+    std::vector<amsynth_midi_cc_t> midi_out;
+    float left[64] = {0}, right[64] = {0};
+    synth.process(64, midi_in, midi_out, left, right);
+
+    // the voices are allocated here and swapped in by the next process()
+    synth.setMaxNumVoices(4);
+    assert(synth.getMaxNumVoices() == 4);
+    assert(synth._voiceAllocationUnit->_voices.size() == VoiceAllocationUnit::kMaxVoices);
+    synth.process(64, midi_in, midi_out, left, right);
+    assert(synth._voiceAllocationUnit->_voices.size() == 4);
+    assert(synth.getMaxNumVoices() == 4);
+
+    synth.setMaxNumVoices(8);
+    synth.setMaxNumVoices(2); // replaces the unclaimed pool
+    synth.process(64, midi_in, midi_out, left, right);
+    assert(synth._voiceAllocationUnit->_voices.size() == 2);
+    assert(synth.getMaxNumVoices() == 2);
+
+    // with process() running concurrently, every change is still picked up
+    std::atomic<bool> running{true};
+    std::thread audio([&] {
+        std::vector<amsynth_midi_event_t> midi_in;
+        std::vector<amsynth_midi_cc_t> midi_out;
+        float left[1], right[1];
+        while (running)
+            synth.process(1, midi_in, midi_out, left, right);
+    });
+    for (int i = 0; i < 2000; i++)
+        synth.setMaxNumVoices(i % 7 + 1);
+    running = false;
+    audio.join();
+    synth.process(64, midi_in, midi_out, left, right);
+    assert(synth._voiceAllocationUnit->_voices.size() == 1999 % 7 + 1);
+    assert(synth.getMaxNumVoices() == 1999 % 7 + 1);
+}
+
+TEST(testNotePriority) {
+    NoteStack stack;
+    stack.push(64); stack.push(60); stack.push(67); stack.push(60);
+    assert(stack.size() == 3);
+    assert(stack.select(NotePriorityLast) == 60);
+    assert(stack.select(NotePriorityLow) == 60);
+    assert(stack.select(NotePriorityHigh) == 67);
+    stack.remove(60);
+    assert(stack.select(NotePriorityLast) == 67 && stack.select(NotePriorityLow) == 64);
+    stack.remove(67); stack.remove(64);
+    assert(stack.empty() && stack.select(NotePriorityHigh) == -1);
+
+    VoiceAllocationUnit vau;
+    vau.SetSampleRate(44100);
+    vau.setKeyboardMode(KeyboardModeMono);
+    vau.SetNotePriority(NotePriorityLow);
+    vau.HandleMidiNoteOn(64, 1.f);
+    vau.HandleMidiNoteOn(60, 1.f);
+    vau.HandleMidiNoteOn(67, 1.f); // higher, so it waits
+    assert(vau._voiceNote[0] == 60);
+    vau.HandleMidiNoteOff(60, 0.f);
+    assert(vau._voiceNote[0] == 64);
+
+    vau.SetNotePriority(NotePriorityLast);
+    vau.HandleMidiNoteOn(60, 1.f);
+    vau.HandleMidiSustainPedal(127);
+    vau.HandleMidiNoteOn(64, 1.f);
+    vau.HandleMidiNoteOff(64, 0.f);
+    assert(vau._voiceNote[0] == 64); // held by the pedal
+    vau.HandleMidiSustainPedal(0);
+    assert(vau._voiceNote[0] == 60); // back to the key still down
+    vau.HandleMidiNoteOff(60, 0.f);
+    assert(vau._heldNotes.empty());
+}
+
+TEST(testThreadedRenderingMatchesSingleThreaded) {
+    VoiceAllocationUnit single, threaded;
+    threaded.SetRenderThreads(4);
+    assert(threaded.GetRenderThreads() == 4);
+
+    Preset preset;
+    for (int i = 0; i < kAmsynthParameterCount; i++) {
+        single.UpdateParameter((Param)i, preset.getParameter(i).getControlValue());
+        threaded.UpdateParameter((Param)i, preset.getParameter(i).getControlValue());
+    }
+
+    float singleL[64], singleR[64], threadedL[64], threadedR[64];
+    for (int block = 0; block < 100; block++) {
+        if (block < 24) {
+            single.HandleMidiNoteOn(36 + block * 2, 1.f);
+            threaded.HandleMidiNoteOn(36 + block * 2, 1.f);
+        }
+        single.Process(singleL, singleR, 64);
+        threaded.Process(threadedL, threadedR, 64);
+        for (int i = 0; i < 64; i++) {
+            assert(fabsf(singleL[i] - threadedL[i]) < 1e-5f);
+            assert(fabsf(singleR[i] - threadedR[i]) < 1e-5f);
+        }
+    }
+}
+
+TEST(testSharedRampsGlide) {
+    // A change to a smoothed parameter glides to the new value rather than
+    // stepping, for the voices already playing
+    VoiceAllocationUnit reference, changed, target;
+    Preset preset;
+    preset.getParameter(kAmsynthParameter_ReverbWet).setValue(0.f);
+    const float volume = preset.getParameter(kAmsynthParameter_MasterVolume).getControlValue();
+    for (VoiceAllocationUnit *vau : { &reference, &changed, &target }) {
+        vau->SetSampleRate(44100);
+        for (int i = 0; i < kAmsynthParameterCount; i++)
+            vau->UpdateParameter((Param)i, preset.getParameter(i).getControlValue());
+        vau->HandleMidiNoteOn(48, 0.3f);
+        vau->HandleMidiNoteOn(55, 0.3f);
+    }
+    target.UpdateParameter(kAmsynthParameter_MasterVolume, volume * 0.5f);
+
+    float referenceL[64], changedL[64], targetL[64], right[64];
+    float step = 0, jump = 0, error = 0;
+    for (int block = 0; block < 200; block++) {
+        if (block == 20)
+            changed.UpdateParameter(kAmsynthParameter_MasterVolume, volume * 0.5f);
+        reference.Process(referenceL, right, 64);
+        changed.Process(changedL, right, 64);
+        target.Process(targetL, right, 64);
+        for (int i = 0; i < 64; i++) {
+            if (block == 20) {
+                step = std::max(step, fabsf(changedL[i] - referenceL[i]));
+                jump = std::max(jump, fabsf(targetL[i] - referenceL[i]));
+            }
+            if (block >= 100)
+                error = std::max(error, fabsf(changedL[i] - targetL[i]));
+        }
+    }
+    assert(step < jump * 0.25f && error < 1e-5f);
+}
+
+TEST(testSharedRampsSnapWhileIdle) {
+    // A change made while no voice is playing, such as a preset switch,
+    // applies straight away to the next note rather than gliding in
+    VoiceAllocationUnit reference, changed;
+    Preset preset;
+    preset.getParameter(kAmsynthParameter_ReverbWet).setValue(0.f);
+    preset.getParameter(kAmsynthParameter_AmpDistortion).setValue(0.f);
+    const float volume = preset.getParameter(kAmsynthParameter_MasterVolume).getControlValue();
+    float referenceL[64], changedL[64], right[64];
+    for (VoiceAllocationUnit *vau : { &reference, &changed }) {
+        vau->SetSampleRate(44100);
+        for (int i = 0; i < kAmsynthParameterCount; i++)
+            vau->UpdateParameter((Param)i, preset.getParameter(i).getControlValue());
+        vau->HandleMidiNoteOn(48, 0.3f);
+        vau->HandleMidiNoteOff(48, 0.f);
+        for (int block = 0; block < 1000 && !vau->IsIdle(); block++)
+            vau->Process(changedL, right, 64);
+        assert(vau->IsIdle());
+    }
+    changed.UpdateParameter(kAmsynthParameter_MasterVolume, volume * 0.5f);
+
+    // the volume is a gain, so the output is exactly halved from the start
+    reference.HandleMidiNoteOn(48, 0.3f);
+    changed.HandleMidiNoteOn(48, 0.3f);
+    float error = 0, peak = 0;
+    for (int block = 0; block < 4; block++) {
+        reference.Process(referenceL, right, 64);
+        changed.Process(changedL, right, 64);
+        for (int i = 0; i < 64; i++) {
+            error = std::max(error, fabsf(changedL[i] - referenceL[i] * 0.5f));
+            peak = std::max(peak, fabsf(referenceL[i]));
+        }
+    }
+    assert(peak > 0 && error < peak * 1e-4f);
+}
+
+TEST(testGlobalLFO) {
+    // Two notes half an LFO period apart, with a square LFO gating the amp:
+    // a global LFO gates them together, their own LFOs never silence both
+    Preset preset;
+    preset.getParameter(kAmsynthParameter_ReverbWet).setValue(0.f);
+    preset.getParameter(kAmsynthParameter_LFOFreq).setValue(2.f); // 4 Hz
+    preset.getParameter(kAmsynthParameter_LFOWaveform).setValue(1.f); // square
+    preset.getParameter(kAmsynthParameter_LFOToAmp).setValue(1.f);
+
+    int quiet[2] = {};
+    for (int mode = LFOModePerVoice; mode <= LFOModeGlobal; mode++) {
+        preset.getParameter(kAmsynthParameter_LFOMode).setValue((float) mode);
+        VoiceAllocationUnit vau;
+        vau.SetSampleRate(44100);
+        for (int i = 0; i < kAmsynthParameterCount; i++)
+            vau.UpdateParameter((Param)i, preset.getParameter(i).getControlValue());
+
+        float left[64], right[64];
+        for (int block = 0; block < 689; block++) {
+            if (block == 0)
+                vau.HandleMidiNoteOn(48, 1.f);
+            if (block == 86) // 5504 frames, about half a period
+                vau.HandleMidiNoteOn(55, 1.f);
+            vau.Process(left, right, 64);
+            for (int i = 0; block >= 200 && i < 64; i++)
+                quiet[mode] += fabsf(left[i]) < 1e-4f;
+        }
+    }
+    assert(quiet[LFOModePerVoice] < 489 * 64 / 20);
+    assert(quiet[LFOModeGlobal] > 489 * 64 / 3);
+}
+
+TEST(testControlPeriod) {
+    // Updating the LFO and filter envelope less often should only change
+    // the output slightly, whatever the block size
+    VoiceAllocationUnit reference, decimated;
+    decimated.SetControlPeriod(16);
+    assert(decimated.GetControlPeriod() == 16);
+
+    Preset preset;
+    preset.getParameter(kAmsynthParameter_LFOFreq).setValue(2.f); // 4 Hz
+    preset.getParameter(kAmsynthParameter_LFOToAmp).setValue(1.f);
+    preset.getParameter(kAmsynthParameter_LFOToFilterCutoff).setValue(1.f);
+    preset.getParameter(kAmsynthParameter_FilterEnvAmount).setValue(4.f);
+    preset.getParameter(kAmsynthParameter_FilterEnvDecay).setValue(0.1f);
+    for (VoiceAllocationUnit *vau : { &reference, &decimated }) {
+        vau->SetSampleRate(44100);
+        vau->SetSVFFilter(true);
+        for (int i = 0; i < kAmsynthParameterCount; i++)
+            vau->UpdateParameter((Param)i, preset.getParameter(i).getControlValue());
+        vau->HandleMidiNoteOn(48, 1.f);
+    }
+
+    float referenceL[64], referenceR[64], decimatedL[64], decimatedR[64];
+    float peak = 0, error = 0;
+    for (int block = 0; block < 1000; block++) {
+        const int frames = 1 + block % 64;
+        reference.Process(referenceL, referenceR, frames);
+        decimated.Process(decimatedL, decimatedR, frames);
+        for (int i = 0; i < frames; i++) {
+            peak = std::max(peak, fabsf(referenceL[i]));
+            error = std::max(error, fabsf(referenceL[i] - decimatedL[i]));
+        }
+    }
+    assert(peak > 0.f && error < peak * 0.03f);
+}
+
+TEST(testBlockSize) {
+    VoiceAllocationUnit vau;
+    vau.SetBlockSize(1024);
+    assert(vau.GetBlockSize() == VoiceBoard::kMaxProcessBufferSize);
+    vau.SetBlockSize(16);
+    assert(vau.GetBlockSize() == 16);
+
+    Synthesizer synth;
+    synth.setSampleRate(44100);
+    synth.setBlockSize(256);
+    unsigned char noteOn[] = { MIDI_STATUS_NOTE_ON, 60, 127 };
+    std::vector<amsynth_midi_event_t> midi_in { { 0, 3, noteOn } };
+    std::vector<amsynth_midi_cc_t> midi_out;
+    float left[1024] = {0}, right[1024] = {0};
+    synth.process(1024, midi_in, midi_out, left, right);
+    float peak = 0;
+    for (int i = 0; i < 1024; i++)
+        peak = std::max(peak, fabsf(left[i]));
+    assert(peak > 0);
+}
+
+TEST(testSilenceIsDetected) {
+    VoiceAllocationUnit vau;
+    vau.SetSampleRate(44100);
+    Preset preset;
+    for (int i = 0; i < kAmsynthParameterCount; i++)
+        vau.UpdateParameter((Param)i, preset.getParameter(i).getControlValue());
+    vau.UpdateParameter(kAmsynthParameter_AmpEnvRelease, 0.f);
+    vau.UpdateParameter(kAmsynthParameter_ReverbWet, 0.5f);
+    vau.UpdateParameter(kAmsynthParameter_ReverbRoomsize, 0.5f);
+
+    float l[64], r[64];
+    vau.Process(l, r, 64);
+    assert(vau.IsIdle());
+
+    vau.HandleMidiNoteOn(60, 1.f);
+    vau.Process(l, r, 64);
+    assert(!vau.IsIdle());
+    vau.HandleMidiNoteOff(60, 0.f);
+
+    // The reverb tail keeps the unit busy after the voice has finished...
+    int blocks = 0;
+    for (; !vau.IsIdle() && blocks < 44100 * 30 / 64; blocks++)
+        vau.Process(l, r, 64);
+    assert(vau._activeCount == 0);
+    assert(blocks > 44100 / 64);
+
+    // ...and then it outputs silence, in blocks of any size
+    float silence[1024];
+    std::fill(silence, silence + 1024, 1.f);
+    vau.Process(silence, silence, 1024);
+    for (int i = 0; i < 1024; i++)
+        assert(silence[i] == 0.f);
+
+    vau.HandleMidiNoteOn(60, 1.f);
+    vau.Process(l, r, 64);
+    assert(!vau.IsIdle() && *std::max_element(l, l + 64) > 0.f);
+}
+
 TEST(testPresetIgnoredParameters) {
     Preset basePreset;
     basePreset.getParameter(0).setValue(1);
@@ -174,6 +522,24 @@ TEST(testPresetIgnoredParameters) {
     assert(!basePreset.isEqual(newPreset));
 }
 
+TEST(testSetParameterValues) {
+    Synthesizer synth;
+    float volume = 0.25f;
+    const float *ports[kAmsynthParameterCount] = {};
+    ports[kAmsynthParameter_MasterVolume] = &volume;
+
+    synth.setParameterValues(ports);
+    assert(synth.getParameterValue(kAmsynthParameter_MasterVolume) == 0.25f);
+
+    // only ports that changed since the last call are applied
+    synth.setParameterValue(kAmsynthParameter_MasterVolume, 0.5f);
+    synth.setParameterValues(ports);
+    assert(synth.getParameterValue(kAmsynthParameter_MasterVolume) == 0.5f);
+    volume = 0.75f;
+    synth.setParameterValues(ports);
+    assert(synth.getParameterValue(kAmsynthParameter_MasterVolume) == 0.75f);
+}
+
 static size_t count(const char **strings) {
     size_t count;
     for (count = 0; strings[count]; count ++);
@@ -188,6 +554,7 @@ TEST(testPresetValueStrings) {
     assert(count(parameter_get_value_strings(kAmsynthParameter_FilterSlope)) == (int)SynthFilter::Slope::k12 + 2);
     assert(count(parameter_get_value_strings(kAmsynthParameter_LFOOscillatorSelect)) == 3);
     assert(count(parameter_get_value_strings(kAmsynthParameter_PortamentoMode)) == PortamentoModeLegato + 1);
+    assert(count(parameter_get_value_strings(kAmsynthParameter_LFOMode)) == LFOModeGlobal + 1);
 }
 
 TEST(testOscillatorHighFrequency) {
@@ -201,6 +568,511 @@ TEST(testOscillatorHighFrequency) {
     }
 }
 
+TEST(testOscillatorSync) {
+    // A synced oscillator restarts its cycle with the master's, so its
+    // output repeats at the master's period (441 samples at 100 Hz)
+    static float buffer[4 * 441];
+    for (int waveform = (int)Oscillator::Waveform::kSine; waveform <= (int)Oscillator::Waveform::kSaw; waveform++) {
+        for (bool bandLimited : { false, true }) {
+            Oscillator osc;
+            osc.SetSampleRate(44100);
+            osc.SetWaveform((Oscillator::Waveform)waveform);
+            osc.setBandLimited(bandLimited);
+            osc.setSyncEnabled(true);
+            for (int i = 0; i < 4 * 441; i += 63)
+                osc.ProcessSamples(buffer + i, std::min(63, 4 * 441 - i), 330, 0.f, 100);
+            for (int i = 441; i < 3 * 441; i++)
+                assert(fabsf(buffer[i] - buffer[i + 441]) < 1e-3f);
+        }
+    }
+}
+
+TEST(testNoiseIsRepeatable) {
+    static float a[100], b[100];
+    Oscillator x, y;
+    x.SetWaveform(Oscillator::Waveform::kNoise);
+    y.SetWaveform(Oscillator::Waveform::kNoise);
+
+    for (int seed = 1; seed <= 2; seed++) {
+        x.setRandomSeed(1);
+        y.setRandomSeed(seed);
+        for (int n : { 37, 63 }) {
+            x.ProcessSamples(a, n, 440.f, 0.f);
+            y.ProcessSamples(b, n, 440.f, 0.f);
+            assert(std::equal(a, a + n, b) == (seed == 1));
+        }
+    }
+
+    float sum = 0;
+    x.ProcessSamples(a, 100, 440.f, 0.f);
+    for (int i = 0; i < 100; i++) {
+        assert(a[i] >= -1.f && a[i] < 1.f);
+        sum += a[i];
+    }
+    assert(fabsf(sum / 100) < 0.2f);
+}
+
+TEST(testBandLimitedOscillator) {
+    const int kFrames = VoiceBoard::kMaxProcessBufferSize;
+    static float naive[kFrames], bandLimited[kFrames];
+    const Oscillator::Waveform waveforms[] = { Oscillator::Waveform::kSine, Oscillator::Waveform::kPulse, Oscillator::Waveform::kSaw };
+    const float shapes[] = { -1.f, -0.5f, 0.f, 0.5f, 1.f };
+
+    Wavetable::prepare();
+    for (Oscillator::Waveform waveform : waveforms) {
+        for (float shape : shapes) {
+            // Well below Nyquist the tables should follow the naive waveform
+            // closely, apart from the ringing around its discontinuities.
+            // The first block is skipped as the frequency glides up from 0.
+            Oscillator a, b;
+            a.SetSampleRate(44100); a.SetWaveform(waveform);
+            b.SetSampleRate(44100); b.SetWaveform(waveform); b.setBandLimited(true);
+            a.ProcessSamples(naive, kFrames, 110.f, shape);
+            b.ProcessSamples(bandLimited, kFrames, 110.f, shape);
+            float error = 0;
+            for (int block = 0; block < 4; block++) {
+                a.ProcessSamples(naive, kFrames, 110.f, shape);
+                b.ProcessSamples(bandLimited, kFrames, 110.f, shape);
+                for (int i = 0; i < kFrames; i++)
+                    error += fabsf(naive[i] - bandLimited[i]);
+            }
+            assert(error / (4 * kFrames) < 0.02f);
+
+            // and near Nyquist they should not overshoot much
+            b.reset();
+            for (int block = 0; block < 4; block++) {
+                b.ProcessSamples(bandLimited, kFrames, 15000.f, shape);
+                for (int i = 0; i < kFrames; i++)
+                    assert(fabsf(bandLimited[i]) < 1.5f);
+            }
+        }
+    }
+}
+
+TEST(testEnvelope) {
+    // Each segment takes the time set, whatever the block size
+    const int kAttack = 441, kDecay = 4410, kRelease = 2205;
+    ADSR adsr;
+    adsr.SetSampleRate(44100);
+    adsr.SetAttack(0.01f);
+    adsr.SetDecay(0.1f);
+    adsr.SetSustain(0.5f);
+    adsr.SetRelease(0.05f);
+    adsr.triggerOn();
+
+    static float env[10000];
+    const int kLength = 8000;
+    for (int i = 0; i < kLength; i += 37)
+        adsr.process(env + i, std::min(37, kLength - i));
+
+    // a linear attack...
+    for (int i = 1; i < kAttack; i++)
+        assert(std::fabs(env[i] - (float) i / kAttack) < 1e-5f);
+    // ...an exponential decay, steepest at the start...
+    assert(std::fabs(env[kAttack] - 1.f) < 1e-5f);
+    for (int i = kAttack + 2; i < kAttack + kDecay; i++)
+        assert(env[i] < env[i - 1] && env[i - 1] - env[i] <= env[i - 2] - env[i - 1] + 1e-6f);
+    assert(env[kAttack + kDecay / 2] < 0.75f);
+    // ...and a sustain that holds
+    for (int i = kAttack + kDecay; i < kLength; i++)
+        assert(std::fabs(env[i] - 0.5f) < 1e-5f);
+
+    // A new sustain level is approached gradually, as ParamSmoother
+    adsr.SetSustain(0.25f);
+    adsr.process(env, 1000);
+    ParamSmoother smoother(0.5f);
+    for (int i = 1; i < 1000; i++)
+        assert(std::fabs(env[i] - smoother.processSample(0.25f)) < 1e-5f);
+
+    adsr.triggerOff();
+    adsr.process(env, kRelease + 1);
+    for (int i = 1; i < kRelease; i++)
+        assert(env[i] < env[i - 1]);
+    assert(env[kRelease - 1] < 1e-4f && env[kRelease] == 0.f && adsr.getState() == 0);
+}
+
+TEST(testFastMath) {
+    // The error bounds documented in FastMath.h
+    double error = 0;
+    for (float x = -256.f; x < 256.f; x += 0.00073f) {
+        error = std::max(error, fabs(fastmath::sin(x) - sin((double)x)));
+        error = std::max(error, fabs(fastmath::cos(x) - cos((double)x)));
+    }
+    assert(error < 5e-7);
+
+    error = 0;
+    for (float x = 0.0001f; x < 1.5f; x += 0.0001f)
+        error = std::max(error, fabs(fastmath::tan(x) / tan((double)x) - 1));
+    assert(error < 3e-6);
+
+    error = 0;
+    for (float x = -126.f; x < 127.f; x += 0.00137f)
+        error = std::max(error, fabs(fastmath::exp2(x) / exp2((double)x) - 1));
+    assert(error < 3e-7);
+
+    error = 0;
+    for (float x = -10.f; x < 10.f; x += 0.0001f)
+        error = std::max(error, fabs(fastmath::exp(x) / exp((double)x) - 1));
+    assert(error < 1e-6);
+
+    error = 0;
+    for (float x = 1e-30f; x < 1e30f; x *= 1.0013f) {
+        const double expected = log2((double)x);
+        error = std::max(error, fabs(fastmath::log2(x) - expected) / std::max(1.0, fabs(expected)));
+    }
+    assert(error < 1e-7);
+
+    error = 0;
+    for (float x = 1e-6f; x < 4.f; x *= 1.0013f)
+        for (float y = 0.01f; y <= 1.f; y += 0.0137f)
+            error = std::max(error, fabs(fastmath::pow(x, y) / pow((double)x, (double)y) - 1));
+    assert(error < 2e-6);
+    assert(fastmath::pow(0.f, 0.5f) == 0.f);
+
+    // The vector versions must match the scalar ones exactly
+    float x[4] = { -3.f, 0.001f, 0.7f, 42.f }, y[4];
+    simd::float4 v = simd::load(x);
+    simd::store(y, fastmath::sin(v));  for (int i = 0; i < 4; i++) assert(y[i] == fastmath::sin(x[i]));
+    simd::store(y, fastmath::cos(v));  for (int i = 0; i < 4; i++) assert(y[i] == fastmath::cos(x[i]));
+    simd::store(y, fastmath::exp(v));  for (int i = 0; i < 4; i++) assert(y[i] == fastmath::exp(x[i]));
+    simd::store(y, fastmath::log2(v)); for (int i = 1; i < 4; i++) assert(y[i] == fastmath::log2(x[i]));
+    simd::store(y, fastmath::pow(v, 0.3f)); for (int i = 0; i < 4; i++) assert(y[i] == fastmath::pow(x[i], 0.3f));
+}
+
+TEST(testDistortion) {
+    static float input[256], buffer[256];
+    for (int i = 0; i < 256; i++)
+        input[i] = sinf(i * 0.1f) * (i % 7 + 1) * 0.3f;
+
+    // No crunch is an exact bypass
+    Distortion distortion;
+    distortion.SetCrunch(0.f);
+    std::copy(input, input + 256, buffer);
+    distortion.Process(buffer, 256);
+    assert(std::equal(input, input + 256, buffer));
+
+    // Once the crunch settles the table follows the curve closely
+    distortion.SetCrunch(0.7f);
+    for (int block = 0; block < 100; block++) {
+        std::copy(input, input + 256, buffer);
+        distortion.Process(buffer, 256);
+    }
+    for (int i = 0; i < 256; i++)
+        assert(fabsf(buffer[i] - copysignf(powf(fabsf(input[i]), 0.3f), input[i])) < 1e-4f);
+
+    // and so does the oversampled version, for a constant input
+    for (int factor : { 2, 4 }) {
+        distortion.SetOversampling(factor);
+        assert(distortion.GetOversampling() == factor);
+        std::fill(buffer, buffer + 256, 0.5f);
+        distortion.Process(buffer, 256);
+        assert(fabsf(buffer[255] - powf(0.5f, 0.3f)) < 1e-3f);
+    }
+}
+
+TEST(testSoftLimiter) {
+    static float l[512], r[512];
+
+    // Quiet signals pass through untouched
+    SoftLimiter limiter;
+    limiter.SetSampleRate(44100);
+    for (int i = 0; i < 512; i++)
+        l[i] = r[i] = 0.2f * sinf(i * 0.05f);
+    limiter.Process(l, r, 512);
+    for (int i = 0; i < 512; i++)
+        assert(l[i] == 0.2f * sinf(i * 0.05f));
+
+    // With lookahead, a sudden loud transient is already limited when it
+    // comes out, delayed by the lookahead. (The release lets the envelope
+    // sag a little below the peak, hence the small margin.)
+    for (float lookahead : { 0.f, 0.002f }) {
+        limiter.SetSampleRate(44100);
+        limiter.SetLookahead(lookahead);
+        const int delay = limiter.GetLookaheadFrames();
+        std::fill(l, l + 512, 0.f);
+        std::fill(r, r + 512, 0.f);
+        std::fill(l + 100, l + 512, 4.f);
+        limiter.Process(l, r, 512);
+        assert(l[100 + delay] > 0.f);
+        if (delay) {
+            assert(l[100 + delay - 1] == 0.f);
+            for (int i = 100 + delay; i < 512; i++)
+                assert(l[i] < 0.901f);
+        } else {
+            assert(l[100] > 0.9f); // too late without lookahead
+        }
+    }
+
+    // At the maximum lookahead, while the envelope decays after a burst, the
+    // gain is that of the delayed frame itself: the oldest in the window
+    static float delayedL[4096], delayedR[4096], directL[4096], directR[4096];
+    SoftLimiter delayed, direct;
+    delayed.SetSampleRate(44100);
+    delayed.SetLookahead(0.01f);
+    direct.SetSampleRate(44100);
+    const int delay = delayed.GetLookaheadFrames();
+    assert(delay == SoftLimiter::kMaxLookahead);
+    for (int i = 0; i < 4096; i++)
+        delayedL[i] = delayedR[i] = directL[i] = directR[i] = (i < 100 ? 2.f : 0.5f) * sinf(i * 0.05f);
+    for (int i = 0; i < 4096; i += 64) {
+        delayed.Process(delayedL + i, delayedR + i, 64);
+        direct.Process(directL + i, directR + i, 64);
+    }
+    for (int i = 100; i + delay < 4096; i++)
+        assert(fabsf(delayedL[i + delay] - directL[i]) < 1e-6f);
+}
+
+TEST(testDenormalGuard) {
+    volatile float tiny = 1e-30f;
+    assert(tiny * 1e-10f != 0.f);
+#if defined(AMSYNTH_DENORMALS_SSE) || defined(AMSYNTH_DENORMALS_AARCH64)
+    {
+        DenormalGuard guard;
+        DenormalGuard::clearUnderflow();
+        assert(tiny * 1e-10f == 0.f);
+        assert(DenormalGuard::underflowed());
+        DenormalGuard::clearUnderflow();
+        assert(!DenormalGuard::underflowed());
+    }
+    assert(tiny * 1e-10f != 0.f);
+#endif
+}
+
+TEST(testReverb) {
+    static float l[4096], r[4096], l2[4096], r2[4096];
+
+    // The delay lines are sized for the sample rate: an impulse reaches the
+    // output through the shortest comb, 1116 samples at 44.1 kHz
+    for (int rate : { 44100, 88200 }) {
+        revmodel reverb;
+        reverb.setrate(rate);
+        reverb.setwet(1);
+        reverb.setdry(0);
+        std::fill(l, l + 4096, 0.f);
+        std::fill(r, r + 4096, 0.f);
+        l[0] = r[0] = 1;
+        reverb.processreplace(l, r, l, r, 4096, 1);
+        const int delay = 1116 * rate / 44100;
+        for (int i = 0; i < delay; i++)
+            assert(l[i] == 0.f);
+        assert(l[delay] != 0.f);
+    }
+
+    // The output doesn't depend on how the input is split into blocks
+    revmodel whole, pieces;
+    whole.setwet(1);
+    pieces.setwet(1);
+    for (int i = 0; i < 4096; i++)
+        l[i] = r[i] = l2[i] = r2[i] = i < 1000 ? sinf(i * 0.3f) : 0.f;
+    whole.processreplace(l, r, l, r, 4096, 1);
+    for (int i = 0, n = 1; i < 4096; i += n, n = n % 97 + 1)
+        pieces.processreplace(l2 + i, r2 + i, l2 + i, r2 + i, std::min(n, 4096 - i), 1);
+    for (int i = 0; i < 4096; i++)
+        assert(std::fabs(l[i] - l2[i]) < 1e-5f && std::fabs(r[i] - r2[i]) < 1e-5f);
+}
+
+TEST(testFilterBankMatchesSingleFilter) {
+    const int kCount = SynthFilter::kMaxLanes - 1;
+    static float single[kCount][VoiceBoard::kMaxProcessBufferSize];
+    static float banked[kCount][VoiceBoard::kMaxProcessBufferSize];
+
+    SynthFilter singleFilters[kCount], bankedFilters[kCount];
+    SynthFilter *filters[kCount];
+    float *buffers[kCount];
+    SynthFilter::Coefficients coefficients[kCount];
+
+    for (int v = 0; v < kCount; v++) {
+        singleFilters[v].SetSampleRate(44100);
+        bankedFilters[v].SetSampleRate(44100);
+        bool enabled = bankedFilters[v].calculateCoefficients(200.f * (v + 1), 0.9f, SynthFilter::Type::kLowPass, coefficients[v]);
+        assert(enabled);
+        filters[v] = &bankedFilters[v];
+        buffers[v] = banked[v];
+    }
+
+    for (int block = 0; block < 4; block++) {
+        for (int v = 0; v < kCount; v++) {
+            for (int i = 0; i < VoiceBoard::kMaxProcessBufferSize; i++) {
+                single[v][i] = banked[v][i] = (i % (v + 7)) < 3 ? 1.f : -1.f;
+            }
+            singleFilters[v].ProcessSamples(single[v], VoiceBoard::kMaxProcessBufferSize, coefficients[v], SynthFilter::Slope::k24);
+        }
+        SynthFilter::ProcessSamples(filters, buffers, coefficients, kCount, VoiceBoard::kMaxProcessBufferSize, SynthFilter::Slope::k24);
+        for (int v = 0; v < kCount; v++) {
+            for (int i = 0; i < VoiceBoard::kMaxProcessBufferSize; i++) {
+                assert(single[v][i] == banked[v][i]);
+            }
+        }
+    }
+}
+
+TEST(testFilterHighResonance) {
+    // The float filter against a double precision direct form biquad, at the
+    // highest resonance the parameter allows and cutoffs across its range
+    const int kSamples = 44100;
+    const float res = 0.97f;
+    const float cutoffs[] = { 10.f, 50.f, 500.f, 5000.f, 21000.f, 70000.f };
+    const SynthFilter::Type types[] = { SynthFilter::Type::kLowPass, SynthFilter::Type::kHighPass, SynthFilter::Type::kBandPass, SynthFilter::Type::kBandStop };
+    static float buffer[kSamples];
+    for (SynthFilter::Type type : types) {
+        for (float cutoff : cutoffs) {
+            const double k = tan(M_PI * std::min(cutoff, 22050.f * 0.99f) / 44100.), k2 = k * k, r = 2. * (1. - res), bh = 1. + r * k + k2;
+            const double b1 = 2. * (k2 - 1.) / bh, b2 = (1. - r * k + k2) / bh;
+            double a0, a1, a2;
+            switch (type) {
+                case SynthFilter::Type::kLowPass:  a0 = k2 / bh;        a1 = 2. * a0; a2 = a0;  break;
+                case SynthFilter::Type::kHighPass: a0 = 1. / bh;        a1 = -2. * a0; a2 = a0; break;
+                case SynthFilter::Type::kBandPass: a0 = r * k / bh;     a1 = 0.;      a2 = -a0; break;
+                default:                           a0 = (1. + k2) / bh; a1 = b1;      a2 = a0;  break;
+            }
+
+            SynthFilter filter;
+            filter.SetSampleRate(44100);
+            for (int i = 0; i < kSamples; i++) {
+                buffer[i] = (i % 441) < 220 ? 0.5f : -0.5f;
+            }
+            for (int i = 0; i < kSamples; i += 64) {
+                filter.ProcessSamples(buffer + i, std::min(64, kSamples - i), cutoff, res, type, SynthFilter::Slope::k24);
+            }
+
+            double d1 = 0, d2 = 0, d3 = 0, d4 = 0, peak = 0, error = 0;
+            for (int i = 0; i < kSamples; i++) {
+                double y, x = (i % 441) < 220 ? 0.5 : -0.5;
+                y = a0 * x + d1; d1 = d2 + a1 * x - b1 * y; d2 = a2 * x - b2 * y; x = y;
+                y = a0 * x + d3; d3 = d4 + a1 * x - b1 * y; d4 = a2 * x - b2 * y;
+                peak = std::max(peak, std::fabs(y));
+                error = std::max(error, std::fabs(y - buffer[i]));
+            }
+            assert(error < peak * 2e-3);
+        }
+    }
+}
+
+TEST(testFilterCoefficientCache) {
+    // Cached coefficients must match freshly calculated ones whenever any
+    // of the inputs (or the sample rate) changes
+    auto matches = [](const SynthFilter::Coefficients &a, const SynthFilter::Coefficients &b) {
+        return a.p1 == b.p1 && a.p2 == b.p2 && a.p3 == b.p3 && a.m0 == b.m0 && a.m1 == b.m1 && a.m2 == b.m2;
+    };
+    const struct { float cutoff, res; SynthFilter::Type type; int rate; } inputs[] = {
+        { 1000.f, 0.5f, SynthFilter::Type::kLowPass, 44100 },
+        { 1000.f, 0.5f, SynthFilter::Type::kLowPass, 44100 },
+        { 2000.f, 0.5f, SynthFilter::Type::kLowPass, 44100 },
+        { 2000.f, 0.8f, SynthFilter::Type::kLowPass, 44100 },
+        { 2000.f, 0.8f, SynthFilter::Type::kHighPass, 44100 },
+        { 2000.f, 0.8f, SynthFilter::Type::kHighPass, 48000 },
+        { 2000.f, 0.8f, SynthFilter::Type::kBypass, 48000 },
+        { 2000.f, 0.8f, SynthFilter::Type::kHighPass, 48000 },
+    };
+    SynthFilter cached;
+    for (const auto &in : inputs) {
+        SynthFilter fresh;
+        fresh.SetSampleRate(in.rate);
+        cached.SetSampleRate(in.rate);
+        SynthFilter::Coefficients expected, actual;
+        bool enabled = fresh.calculateCoefficients(in.cutoff, in.res, in.type, expected);
+        assert(cached.calculateCoefficients(in.cutoff, in.res, in.type, actual) == enabled);
+        assert(!enabled || matches(expected, actual));
+    }
+}
+
+TEST(testSVFFilterMatchesFixedCutoff) {
+    // A cutoff that doesn't move should give the same result either way
+
+    const int kCount = SynthFilter::kMaxLanes - 1, kSamples = 1000;
+    const SynthFilter::Type types[] = { SynthFilter::Type::kLowPass, SynthFilter::Type::kHighPass, SynthFilter::Type::kBandPass, SynthFilter::Type::kBandStop };
+    const SynthFilter::Slope slopes[] = { SynthFilter::Slope::k12, SynthFilter::Slope::k24 };
+    for (SynthFilter::Type type : types) {
+        for (SynthFilter::Slope slope : slopes) {
+            static float fixed[kCount][kSamples], svf[kCount][kSamples], cutoff[kCount][kSamples];
+            SynthFilter fixedFilters[kCount], svfFilters[kCount];
+            SynthFilter *filters[kCount];
+            float *buffers[kCount];
+            const float *cutoffs[kCount];
+            float res[kCount];
+            for (int v = 0; v < kCount; v++) {
+                fixedFilters[v].SetSampleRate(44100);
+                svfFilters[v].SetSampleRate(44100);
+                res[v] = 0.9f * v / (kCount - 1);
+                for (int i = 0; i < kSamples; i++) {
+                    fixed[v][i] = svf[v][i] = (i % (v + 20)) < 7 ? 0.5f : -0.5f;
+                    cutoff[v][i] = 300.f * (v + 1) * (v + 1);
+                }
+                fixedFilters[v].ProcessSamples(fixed[v], kSamples, cutoff[v][0], res[v], type, slope);
+                filters[v] = &svfFilters[v];
+                buffers[v] = svf[v];
+                cutoffs[v] = cutoff[v];
+            }
+            SynthFilter::ProcessSamples(filters, buffers, cutoffs, res, kCount, kSamples, type, slope);
+            for (int v = 0; v < kCount; v++) {
+                for (int i = 0; i < kSamples; i++) {
+                    assert(std::fabs(fixed[v][i] - svf[v][i]) < 1e-3f);
+                }
+            }
+        }
+    }
+
+    // Sweeping the cutoff at audio rate with high resonance stays bounded
+    static float buffer[VoiceBoard::kMaxProcessBufferSize], cutoff[VoiceBoard::kMaxProcessBufferSize];
+    SynthFilter filter;
+    filter.SetSampleRate(44100);
+    SynthFilter *filters[] = { &filter };
+    float *buffers[] = { buffer };
+    const float *cutoffs[] = { cutoff };
+    const float res = 0.95f;
+    float peak = 0;
+    for (int block = 0; block < 100; block++) {
+        for (int i = 0; i < VoiceBoard::kMaxProcessBufferSize; i++) {
+            const int t = block * VoiceBoard::kMaxProcessBufferSize + i;
+            buffer[i] = (t % 100) < 50 ? 0.5f : -0.5f;
+            cutoff[i] = 11000.f + 10990.f * std::sin(t * 0.05f);
+        }
+        SynthFilter::ProcessSamples(filters, buffers, cutoffs, &res, 1, VoiceBoard::kMaxProcessBufferSize, SynthFilter::Type::kLowPass, SynthFilter::Slope::k24);
+        for (float x : buffer)
+            peak = std::max(peak, std::fabs(x));
+    }
+    assert(std::isfinite(peak) && peak < 50.f);
+}
+
+TEST(testCPULevelsMatch) {
+    // Every level the CPU supports gives the same result, to rounding
+
+    const cpu::Level active = cpu::active(), levels[] = { cpu::Level::kBaseline, cpu::supported() };
+    const int kCount = SynthFilter::kMaxLanes, kSamples = 300;
+    static float output[2][2][kCount][kSamples], cutoff[kCount][kSamples];
+    const float res[kCount] = { 0.f, 0.3f, 0.6f, 0.9f };
+    for (int l = 0; l < 2; l++) {
+        cpu::force(levels[l]);
+        SynthFilter fixedFilters[kCount], svfFilters[kCount];
+        SynthFilter *fixed[kCount], *svf[kCount];
+        SynthFilter::Coefficients coefficients[kCount];
+        float *fixedBuffers[kCount], *svfBuffers[kCount];
+        const float *cutoffs[kCount];
+        for (int v = 0; v < kCount; v++) {
+            fixedFilters[v].SetSampleRate(44100);
+            svfFilters[v].SetSampleRate(44100);
+            for (int i = 0; i < kSamples; i++) {
+                output[l][0][v][i] = output[l][1][v][i] = (i % (v + 20)) < 7 ? 0.5f : -0.5f;
+                cutoff[v][i] = 5000.f + 4000.f * std::sin(i * 0.01f * (v + 1));
+            }
+            fixedFilters[v].calculateCoefficients(2000.f * (v + 1), res[v], SynthFilter::Type::kLowPass, coefficients[v]);
+            fixed[v] = &fixedFilters[v];
+            svf[v] = &svfFilters[v];
+            fixedBuffers[v] = output[l][0][v];
+            svfBuffers[v] = output[l][1][v];
+            cutoffs[v] = cutoff[v];
+        }
+        SynthFilter::ProcessSamples(fixed, fixedBuffers, coefficients, kCount, kSamples, SynthFilter::Slope::k24);
+        SynthFilter::ProcessSamples(svf, svfBuffers, cutoffs, res, kCount, kSamples, SynthFilter::Type::kLowPass, SynthFilter::Slope::k24);
+    }
+    cpu::force(active);
+
+    for (int f = 0; f < 2; f++)
+        for (int v = 0; v < kCount; v++)
+            for (int i = 0; i < kSamples; i++)
+                assert(std::fabs(output[0][f][v][i] - output[1][f][v][i]) < 1e-4f);
+}
+
 #define RUN_TEST(testFunction) do { printf("%s()... ", #testFunction); testFunction(); printf("OK\n"); } while (0)
 
 int main(int argc, const char * argv[])  {
@@ -208,7 +1080,33 @@ int main(int argc, const char * argv[])  {
     RUN_TEST(testMidiOutput_OnOff);
     RUN_TEST(testPresetIgnoredParameters);
     RUN_TEST(testPresetValueStrings);
+    RUN_TEST(testSetParameterValues);
     RUN_TEST(testMidiAllNotesOff);
+    RUN_TEST(testVoiceStealing);
+    RUN_TEST(testRepeatedNoteKeepsTail);
+    RUN_TEST(testMaxVoicesWhileProcessing);
+    RUN_TEST(testNotePriority);
+    RUN_TEST(testThreadedRenderingMatchesSingleThreaded);
+    RUN_TEST(testBlockSize);
+    RUN_TEST(testGlobalLFO);
+    RUN_TEST(testControlPeriod);
+    RUN_TEST(testSharedRampsGlide);
+    RUN_TEST(testSharedRampsSnapWhileIdle);
+    RUN_TEST(testSilenceIsDetected);
     RUN_TEST(testOscillatorHighFrequency);
+    RUN_TEST(testOscillatorSync);
+    RUN_TEST(testBandLimitedOscillator);
+    RUN_TEST(testNoiseIsRepeatable);
+    RUN_TEST(testEnvelope);
+    RUN_TEST(testFastMath);
+    RUN_TEST(testDistortion);
+    RUN_TEST(testSoftLimiter);
+    RUN_TEST(testDenormalGuard);
+    RUN_TEST(testReverb);
+    RUN_TEST(testFilterBankMatchesSingleFilter);
+    RUN_TEST(testFilterHighResonance);
+    RUN_TEST(testFilterCoefficientCache);
+    RUN_TEST(testSVFFilterMatchesFixedCutoff);
+    RUN_TEST(testCPULevelsMatch);
     return 0;
 }